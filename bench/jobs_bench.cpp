@@ -0,0 +1,145 @@
+// Headless job system benchmark: generates a square of terrain chunk columns and meshes them
+// as jobs the way World does when pregenerating, once per worker count from 1 up to the
+// maximum, doubling. Reports chunks per second and the speedup over one thread, and a
+// checksum of every face that has to come out the same at every thread count.
+//
+//   ZenixJobsBench [columns] [max threads]
+
+#include "chunk_mesher.hpp"
+#include "defines.hpp"
+#include "job_system.hpp"
+#include "terrain_generator.hpp"
+#include "voxel.hpp"
+#include "voxel_arena.hpp"
+#include "voxel_palette.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace zx;
+
+namespace {
+
+constexpr int LAYERS = 4;
+
+double secondsSince(std::chrono::high_resolution_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+struct Run {
+  double generateSeconds;
+  double meshSeconds;
+  uint64_t checksum;
+};
+
+Run run(unsigned threads, int columns) {
+  // the thread calling wait runs jobs too
+  JobSystem jobs{threads - 1};
+  TerrainGenerator terrain{1234, 0};
+  int chunkCount = columns * columns * LAYERS;
+  auto indexOf = [&](const glm::ivec3& p) { return (p.z * columns + p.x) * LAYERS + p.y; };
+  auto positionOf = [&](int index) {
+    return glm::ivec3{index / LAYERS % columns, index % LAYERS, index / LAYERS / columns};
+  };
+
+  // results land by chunk index, so the order jobs finish in does not matter
+  std::vector<PalettedVoxels> generated(chunkCount);
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int c = 0; c < columns * columns; c++) {
+    jobs.submit([&, c] {
+      glm::ivec2 column{c % columns, c / columns};
+      TerrainGenerator::HeightMap heights;
+      terrain.heightMap(column, heights);
+      for (int y = 0; y < LAYERS; y++) {
+        glm::ivec3 position{column.x, y, column.y};
+        terrain.fillChunk(position, heights, generated[indexOf(position)]);
+      }
+    });
+  }
+  jobs.wait();
+  double generateSeconds = secondsSince(start);
+
+  std::vector<std::vector<ChunkMesher::Face>> faces(chunkCount);
+  start = std::chrono::high_resolution_clock::now();
+  for (int index = 0; index < chunkCount; index++) {
+    jobs.submit([&, index] {
+      // what a mesh job does, from the generated palettes instead of a snapshot
+      thread_local ChunkMesher mesher;
+      VoxelScratch& scratch = voxelScratch();
+      glm::ivec3 position = positionOf(index);
+      ChunkVoxels view;
+      if (generated[index].isUniform()) {
+        view.uniform = generated[index].get(0);
+      } else {
+        generated[index].decode(scratch.decoded.data());
+        view.voxels = scratch.decoded.data();
+      }
+      for (int face = 0; face < 6; face++) {
+        glm::ivec3 next = position + voxel_normals[face];
+        if (next.x < 0 || next.x >= columns || next.y < 0 || next.y >= LAYERS || next.z < 0 || next.z >= columns) {
+          continue;
+        }
+        int slice = voxel_normals[face][face_axis[face]] > 0 ? 0 : CHUNK_SIZE - 1;
+        generated[indexOf(next)].decodeLayer(face_axis[face], slice, scratch.neighbours[face].data());
+        view.neighbours[face] = scratch.neighbours[face].data();
+      }
+      ChunkMesher::SliceMasks slices;
+      slices.fill(ChunkMesher::ALL_SLICES);
+      mesher.clear();
+      mesher.remesh(slices, view);
+      faces[index] = mesher.faces;
+    });
+  }
+  jobs.wait();
+  double meshSeconds = secondsSince(start);
+
+  uint64_t checksum = 1469598103934665603ull;
+  for (const std::vector<ChunkMesher::Face>& chunkFaces : faces) {
+    for (const ChunkMesher::Face& face : chunkFaces) {
+      unsigned char bytes[sizeof(ChunkMesher::Face)];
+      std::memcpy(bytes, &face, sizeof(bytes));
+      for (unsigned char byte : bytes) {
+        checksum = (checksum ^ byte) * 1099511628211ull;
+      }
+    }
+  }
+  return {generateSeconds, meshSeconds, checksum};
+}
+
+}
+
+int main(int argc, char** argv) {
+  int columns = argc > 1 ? std::atoi(argv[1]) : 32;
+  unsigned maxThreads = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : JobSystem::defaultWorkerCount() + 1;
+  columns = std::max(columns, 1);
+  maxThreads = std::max(maxThreads, 1u);
+  double chunkCount = static_cast<double>(columns * columns * LAYERS);
+  std::printf("%d chunks, up to %u threads\n", columns * columns * LAYERS, maxThreads);
+
+  std::printf("%-8s %14s %14s %9s %18s\n", "threads", "generate/s", "mesh/s", "speedup", "checksum");
+  double baseline = 0.0;
+  uint64_t expected = 0;
+  bool deterministic = true;
+  for (unsigned threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+    Run result = run(threads, columns);
+    double seconds = result.generateSeconds + result.meshSeconds;
+    if (threads == 1) {
+      baseline = seconds;
+      expected = result.checksum;
+    }
+    deterministic = deterministic && result.checksum == expected;
+    std::printf("%-8u %14.0f %14.0f %8.2fx %18llx\n", threads, chunkCount / result.generateSeconds,
+                chunkCount / result.meshSeconds, baseline / seconds,
+                static_cast<unsigned long long>(result.checksum));
+    if (threads == maxThreads) {
+      break;
+    }
+  }
+  std::printf(deterministic ? "same faces at every thread count\n" : "faces differ between thread counts\n");
+  return deterministic ? 0 : 1;
+}
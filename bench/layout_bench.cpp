@@ -0,0 +1,277 @@
+// Headless voxel layout benchmark: runs neighbour heavy kernels over a world of chunks stored
+// in linear and in Morton order and reports throughput and, where perf events are available,
+// cache misses. Pick the layout for voxelIndex (ZX_MORTON_VOXELS) from this.
+//
+//   ZenixLayoutBench [chunks] [repetitions]
+
+#include "defines.hpp"
+#include "voxel.hpp"
+
+#include <glm/gtc/noise.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace zx;
+
+namespace {
+
+// One hardware counter for the calling thread, reads -1 where perf events are not available.
+class PerfCounter {
+ public:
+  enum Event {
+    l1dReadMisses,
+    cacheMisses // last level cache on most CPUs
+  };
+
+  explicit PerfCounter(Event event) {
+#ifdef __linux__
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    if (event == l1dReadMisses) {
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+    } else {
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    }
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+    (void)event;
+#endif
+  }
+  ~PerfCounter() {
+#ifdef __linux__
+    if (fd >= 0) {
+      close(fd);
+    }
+#endif
+  }
+
+  void start() {
+#ifdef __linux__
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+  long long stop() {
+#ifdef __linux__
+    long long count = 0;
+    if (fd >= 0 && ioctl(fd, PERF_EVENT_IOC_DISABLE, 0) == 0 && read(fd, &count, sizeof(count)) == sizeof(count)) {
+      return count;
+    }
+#endif
+    return -1;
+  }
+
+ private:
+  int fd = -1;
+};
+
+// chunks of fractal simplex terrain laid out with Layout, a row of columns two chunks high
+template <typename Layout>
+std::vector<std::vector<Voxel>> terrain(int chunkCount) {
+  std::vector<std::vector<Voxel>> chunks;
+  for (int c = 0; c < chunkCount; c++) {
+    int cx = c / 2;
+    int cy = c % 2;
+    std::vector<Voxel> voxels(CHUNK_VOLUME);
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+      for (int x = 0; x < CHUNK_SIZE; x++) {
+        glm::vec2 world{cx * CHUNK_SIZE + x, z};
+        float value = 0.f;
+        float amplitude = 1.f;
+        float total = 0.f;
+        for (int octave = 0; octave < 4; octave++) {
+          value += amplitude * (glm::simplex(world * (0.02f * float(1 << octave))) + 1.f) / 2.f;
+          total += amplitude;
+          amplitude *= 0.5f;
+        }
+        int height = static_cast<int>(value / total * 2 * CHUNK_SIZE);
+        for (int y = 0; y < CHUNK_SIZE; y++) {
+          int voxel_y = cy * CHUNK_SIZE + y;
+          Voxel voxel = voxel_y < height - 3 ? stone : voxel_y < height ? grass : voxel_y < WATER_LEVEL ? water : air;
+          voxels[Layout::index(x, y, z)] = voxel;
+        }
+      }
+    }
+    chunks.push_back(std::move(voxels));
+  }
+  return chunks;
+}
+
+template <typename Layout>
+Voxel at(const std::vector<Voxel>& voxels, int x, int y, int z) {
+  if (x < 0 || y < 0 || z < 0 || x >= CHUNK_SIZE || y >= CHUNK_SIZE || z >= CHUNK_SIZE) {
+    return air;
+  }
+  return voxels[Layout::index(x, y, z)];
+}
+
+// what the culled mesher does: every solid voxel looks at its six face neighbours
+template <typename Layout>
+uint64_t visibleFaces(const std::vector<Voxel>& voxels) {
+  uint64_t faces = 0;
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      for (int x = 0; x < CHUNK_SIZE; x++) {
+        Voxel voxel = voxels[Layout::index(x, y, z)];
+        if (voxel == air) {
+          continue;
+        }
+        for (const glm::ivec3& n : voxel_normals) {
+          Voxel neighbour = at<Layout>(voxels, x + n.x, y + n.y, z + n.z);
+          faces += !isOpaque(neighbour) && neighbour != voxel;
+        }
+      }
+    }
+  }
+  return faces;
+}
+
+// vertex ambient occlusion of top faces: the eight voxels around each exposed top face
+template <typename Layout>
+uint64_t ambientOcclusion(const std::vector<Voxel>& voxels) {
+  uint64_t occluders = 0;
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      for (int x = 0; x < CHUNK_SIZE; x++) {
+        if (!isOpaque(voxels[Layout::index(x, y, z)]) || isOpaque(at<Layout>(voxels, x, y + 1, z))) {
+          continue;
+        }
+        for (int dz = -1; dz <= 1; dz++) {
+          for (int dx = -1; dx <= 1; dx++) {
+            occluders += (dx != 0 || dz != 0) && isOpaque(at<Layout>(voxels, x + dx, y + 1, z + dz));
+          }
+        }
+      }
+    }
+  }
+  return occluders;
+}
+
+// sky light spreading down and sideways, a few relaxation passes over a light byte per voxel
+template <typename Layout>
+uint64_t lighting(const std::vector<Voxel>& voxels, std::vector<uint8_t>& light) {
+  const uint8_t SKY = 15;
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      for (int x = 0; x < CHUNK_SIZE; x++) {
+        light[Layout::index(x, y, z)] = y == CHUNK_SIZE - 1 && !isOpaque(voxels[Layout::index(x, y, z)]) ? SKY : 0;
+      }
+    }
+  }
+  for (int pass = 0; pass < 4; pass++) {
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+      for (int y = CHUNK_SIZE - 1; y >= 0; y--) {
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+          int index = Layout::index(x, y, z);
+          if (isOpaque(voxels[index])) {
+            continue;
+          }
+          uint8_t brightest = light[index];
+          for (int face = 0; face < 6; face++) {
+            glm::ivec3 n = glm::ivec3{x, y, z} + voxel_normals[face];
+            if (n.x < 0 || n.y < 0 || n.z < 0 || n.x >= CHUNK_SIZE || n.y >= CHUNK_SIZE || n.z >= CHUNK_SIZE) {
+              continue;
+            }
+            uint8_t from = light[Layout::index(n.x, n.y, n.z)];
+            // straight down from the sky keeps full strength
+            uint8_t spread = face == 4 && from == SKY ? SKY : from > 0 ? from - 1 : 0;
+            brightest = std::max(brightest, spread);
+          }
+          light[index] = brightest;
+        }
+      }
+    }
+  }
+  uint64_t total = 0;
+  for (uint8_t value : light) {
+    total += value;
+  }
+  return total;
+}
+
+struct Result {
+  double voxelsPerSecond;
+  long long l1Misses;
+  long long cacheMisses;
+  uint64_t checksum;
+};
+
+template <typename Kernel>
+Result run(const std::vector<std::vector<Voxel>>& chunks, int repetitions, Kernel kernel) {
+  PerfCounter l1{PerfCounter::l1dReadMisses};
+  PerfCounter llc{PerfCounter::cacheMisses};
+
+  uint64_t checksum = 0;
+  l1.start();
+  llc.start();
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < repetitions; r++) {
+    for (const std::vector<Voxel>& voxels : chunks) {
+      checksum += kernel(voxels);
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+  long long l1Misses = l1.stop();
+  long long cacheMisses = llc.stop();
+
+  double voxels = static_cast<double>(chunks.size()) * (CHUNK_VOLUME) * repetitions;
+  return {voxels / seconds, l1Misses, cacheMisses, checksum};
+}
+
+void print(const char* kernel, const char* layout, const Result& result, double voxels) {
+  auto perVoxel = [&](long long count) { return count < 0 ? -1.0 : count / voxels; };
+  std::printf("%-10s %-8s %14.1f %16.4f %16.4f %20llu\n", kernel, layout, result.voxelsPerSecond / 1e6,
+              perVoxel(result.l1Misses), perVoxel(result.cacheMisses),
+              static_cast<unsigned long long>(result.checksum));
+}
+
+template <typename Layout>
+void runLayout(const char* name, int chunkCount, int repetitions) {
+  std::vector<std::vector<Voxel>> chunks = terrain<Layout>(chunkCount);
+  std::vector<uint8_t> light(CHUNK_VOLUME);
+  double voxels = static_cast<double>(chunkCount) * (CHUNK_VOLUME) * repetitions;
+
+  print("faces", name, run(chunks, repetitions, visibleFaces<Layout>), voxels);
+  print("ao", name, run(chunks, repetitions, ambientOcclusion<Layout>), voxels);
+  print("lighting", name,
+        run(chunks, repetitions, [&](const std::vector<Voxel>& v) { return lighting<Layout>(v, light); }),
+        voxels);
+}
+
+}
+
+int main(int argc, char** argv) {
+  // the default world is larger than most last level caches
+  int chunkCount = argc > 1 ? std::atoi(argv[1]) : 512;
+  int repetitions = argc > 2 ? std::atoi(argv[2]) : 3;
+  chunkCount = std::max(chunkCount, 1);
+  repetitions = std::max(repetitions, 1);
+
+  std::printf("%d chunks, %d repetitions, misses are -1 without perf counters\n", chunkCount, repetitions);
+  std::printf("%-10s %-8s %14s %16s %16s %20s\n", "kernel", "layout", "Mvoxels/s", "L1D miss/voxel",
+              "cache miss/voxel", "checksum");
+  runLayout<LinearLayout>("linear", chunkCount, repetitions);
+  runLayout<MortonLayout>("morton", chunkCount, repetitions);
+  return 0;
+}
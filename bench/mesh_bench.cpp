@@ -0,0 +1,155 @@
+// Headless meshing benchmark: runs every CPU meshing strategy over synthetic and generated
+// chunks and reports throughput and face buffer size. No Vulkan device or window is needed.
+//
+//   ZenixMeshBench [repetitions]
+
+#include "chunk_mesher.hpp"
+#include "defines.hpp"
+#include "voxel.hpp"
+
+#include <glm/gtc/noise.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace zx;
+
+namespace {
+
+using ChunkData = std::vector<Voxel>;
+
+ChunkData fillChunk(const std::function<Voxel(int, int, int)>& voxelAt) {
+  ChunkData voxels(CHUNK_VOLUME);
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      for (int x = 0; x < CHUNK_SIZE; x++) {
+        voxels[voxelIndex(x, y, z)] = voxelAt(x, y, z);
+      }
+    }
+  }
+  return voxels;
+}
+
+// a set of chunks meshed together, neighbours[i] are the face neighbours of chunks[i]
+struct Scene {
+  std::string name;
+  std::vector<ChunkData> chunks;
+  std::vector<std::array<int, 6>> neighbours;
+};
+
+Scene singleChunk(const std::string& name, const std::function<Voxel(int, int, int)>& voxelAt) {
+  Scene scene;
+  scene.name = name;
+  scene.chunks.push_back(fillChunk(voxelAt));
+  scene.neighbours.push_back({-1, -1, -1, -1, -1, -1});
+  return scene;
+}
+
+// fractal simplex heightmap over a grid of chunk columns, water fills up to WATER_LEVEL
+Scene terrain(int columns, int layers) {
+  Scene scene;
+  scene.name = "terrain " + std::to_string(columns) + "x" + std::to_string(layers) + "x" + std::to_string(columns);
+  auto index = [&](int cx, int cy, int cz) { return cx + cy * columns + cz * columns * layers; };
+  for (int cz = 0; cz < columns; cz++) {
+    for (int cy = 0; cy < layers; cy++) {
+      for (int cx = 0; cx < columns; cx++) {
+        scene.chunks.push_back(fillChunk([&](int x, int y, int z) {
+          glm::vec2 world{cx * CHUNK_SIZE + x, cz * CHUNK_SIZE + z};
+          float value = 0.f;
+          float amplitude = 1.f;
+          float total = 0.f;
+          for (int octave = 0; octave < 5; octave++) {
+            value += amplitude * (glm::simplex(world * (0.008f * float(1 << octave))) + 1.f) / 2.f;
+            total += amplitude;
+            amplitude *= 0.5f;
+          }
+          int height = static_cast<int>(value / total * layers * CHUNK_SIZE);
+          int voxel_y = cy * CHUNK_SIZE + y;
+          if (voxel_y < height - 3) return stone;
+          if (voxel_y < height) return voxel_y < WATER_LEVEL ? sand : grass;
+          if (voxel_y < WATER_LEVEL) return water;
+          return air;
+        }));
+      }
+    }
+  }
+  for (int cz = 0; cz < columns; cz++) {
+    for (int cy = 0; cy < layers; cy++) {
+      for (int cx = 0; cx < columns; cx++) {
+        std::array<int, 6> n;
+        for (int face = 0; face < 6; face++) {
+          glm::ivec3 p = glm::ivec3{cx, cy, cz} + voxel_normals[face];
+          bool inside = p.x >= 0 && p.x < columns && p.y >= 0 && p.y < layers && p.z >= 0 && p.z < columns;
+          n[face] = inside ? index(p.x, p.y, p.z) : -1;
+        }
+        scene.neighbours.push_back(n);
+      }
+    }
+  }
+  return scene;
+}
+
+std::vector<Scene> scenes() {
+  std::vector<Scene> result;
+  result.push_back(singleChunk("empty", [](int, int, int) { return air; }));
+  result.push_back(singleChunk("solid", [](int, int, int) { return stone; }));
+  result.push_back(singleChunk("half slab", [](int, int y, int) { return y < CHUNK_SIZE / 2 ? stone : air; }));
+  // every voxel face visible, the worst case for every strategy
+  result.push_back(singleChunk("checkerboard", [](int x, int y, int z) { return (x + y + z) % 2 ? stone : air; }));
+  std::mt19937 rng{1234};
+  result.push_back(singleChunk("random", [&](int, int, int) { return static_cast<Voxel>(rng() % VOXEL_TYPES); }));
+  result.push_back(terrain(4, 2));
+  return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+  int repetitions = argc > 1 ? std::atoi(argv[1]) : 20;
+  if (repetitions < 1) {
+    repetitions = 1;
+  }
+
+  const MeshingStrategy strategies[] = {MeshingStrategy::culled, MeshingStrategy::greedy, MeshingStrategy::binary};
+
+  std::printf("%-16s %-8s %12s %12s %14s\n", "scene", "mesher", "chunks/s", "faces/chunk", "bytes/chunk");
+  for (const Scene& scene : scenes()) {
+    std::vector<ChunkVoxels> views(scene.chunks.size());
+    for (size_t i = 0; i < scene.chunks.size(); i++) {
+      views[i].voxels = scene.chunks[i].data();
+      for (int face = 0; face < 6; face++) {
+        int n = scene.neighbours[i][face];
+        views[i].neighbours[face] = n >= 0 ? scene.chunks[n].data() : nullptr;
+      }
+    }
+
+    for (MeshingStrategy strategy : strategies) {
+      ChunkMesher mesher;
+      mesher.meshing = strategy;
+      ChunkMesher::SliceMasks all;
+      all.fill(ChunkMesher::ALL_SLICES);
+
+      size_t faces = 0;
+      auto start = std::chrono::high_resolution_clock::now();
+      for (int r = 0; r < repetitions; r++) {
+        faces = 0;
+        for (const ChunkVoxels& view : views) {
+          mesher.remesh(all, view);
+          faces += mesher.faces.size();
+        }
+      }
+      double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+      double chunks = static_cast<double>(views.size()) * repetitions;
+      double facesPerChunk = static_cast<double>(faces) / views.size();
+      std::printf("%-16s %-8s %12.0f %12.0f %14.0f\n", scene.name.c_str(), meshingStrategyName(strategy),
+                  chunks / seconds, facesPerChunk, facesPerChunk * sizeof(ChunkMesher::Face));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,130 @@
+// Headless noise benchmark: glm::simplex one point at a time against simplexBatch on the same
+// points, and the terrain noise of a chunk column the way World computed it before against a
+// runtime NoiseGraph and TerrainNoise, the same graph fixed at compile time. Fails when a
+// batched sample strays further than SIMPLEX_TOLERANCE from glm or the two graphs disagree.
+//
+//   ZenixNoiseBench [samples] [columns]
+
+#include "defines.hpp"
+#include "noise_graph.hpp"
+#include "simplex_noise.hpp"
+#include "terrain_generator.hpp"
+
+#include <glm/gtc/noise.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace zx;
+
+namespace {
+
+double secondsSince(std::chrono::high_resolution_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// getNoiseAt as World had it, a glm::simplex per sample and octave
+float getNoiseAt(float voxel_x, float voxel_z, const NoiseSettings& settings, int seed) {
+  float value = 0;
+  float accumulated_amplitudes = 0;
+  for (int i = 0; i < settings.octaves; i++) {
+    float frequency = std::pow(2.0f, static_cast<float>(i));
+    float amplitude = std::pow(settings.roughness, static_cast<float>(i));
+    float x = voxel_x * frequency / settings.smoothness;
+    float y = voxel_z * frequency / settings.smoothness;
+    float noise = glm::simplex(glm::vec3{seed + x, seed + y, seed});
+    noise = (noise + 1.0f) / 2.0f;
+    value += noise * amplitude;
+    accumulated_amplitudes += amplitude;
+  }
+  return value / accumulated_amplitudes;
+}
+
+// the terrain noise of a chunk column as World had it, two getNoiseAt per voxel column
+void noiseColumn(const glm::ivec2& column, int seed, NoiseColumn& out) {
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      float voxel_x = static_cast<float>(x) + static_cast<float>(column.x) * CHUNK_SIZE;
+      float voxel_z = static_cast<float>(z) + static_cast<float>(column.y) * CHUNK_SIZE;
+      float result = getNoiseAt(voxel_x, voxel_z, TERRAIN_SHAPE, seed) * getNoiseAt(voxel_x, voxel_z, TERRAIN_DETAIL, seed);
+      out[z * CHUNK_SIZE + x] = result * TERRAIN_SHAPE.amplitude + TERRAIN_SHAPE.offset;
+    }
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  int samples = argc > 1 ? std::atoi(argv[1]) : 1 << 20;
+  int columns = argc > 2 ? std::atoi(argv[2]) : 16;
+  samples = std::max(samples, 1);
+  columns = std::max(columns, 1);
+  const int seed = 1234;
+
+  // spread like terrain samples: the seed plus a few hundred noise cells either way
+  std::mt19937 random{7};
+  std::uniform_real_distribution<float> offset{-500.f, 500.f};
+  std::vector<float> x(samples), y(samples), expected(samples), batched(samples);
+  for (int i = 0; i < samples; i++) {
+    x[i] = seed + offset(random);
+    y[i] = seed + offset(random);
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < samples; i++) {
+    expected[i] = glm::simplex(glm::vec3{x[i], y[i], static_cast<float>(seed)});
+  }
+  double glmSeconds = secondsSince(start);
+  start = std::chrono::high_resolution_clock::now();
+  simplexBatch(x.data(), y.data(), static_cast<float>(seed), batched.data(), samples);
+  double batchSeconds = secondsSince(start);
+
+  float maxError = 0.f;
+  for (int i = 0; i < samples; i++) {
+    maxError = std::max(maxError, std::fabs(batched[i] - expected[i]));
+  }
+
+  // one of each per column, so every way gets the same cache state
+  NoiseGraph runtime{{TERRAIN_SHAPE, TERRAIN_DETAIL}};
+  NoiseColumn scalarNoise, runtimeNoise, fixedNoise;
+  int columnCount = columns * columns;
+  double columnSeconds[3] = {};
+  float maxHeightError = 0.f;
+  size_t graphMismatches = 0;
+  for (int c = 0; c < columnCount; c++) {
+    glm::ivec2 column{c % columns, c / columns};
+    start = std::chrono::high_resolution_clock::now();
+    noiseColumn(column, seed, scalarNoise);
+    columnSeconds[0] += secondsSince(start);
+    start = std::chrono::high_resolution_clock::now();
+    runtime.sample(column, seed, runtimeNoise);
+    columnSeconds[1] += secondsSince(start);
+    start = std::chrono::high_resolution_clock::now();
+    TerrainNoise::sample(column, seed, fixedNoise);
+    columnSeconds[2] += secondsSince(start);
+    for (int i = 0; i < CHUNK_AREA; i++) {
+      maxHeightError = std::max(maxHeightError, std::fabs(fixedNoise[i] - scalarNoise[i]));
+      graphMismatches += fixedNoise[i] != runtimeNoise[i];
+    }
+  }
+
+  std::printf("%s, %d lanes, %d samples, %d columns\n", SIMPLEX_PATH, SIMPLEX_LANES, samples, columnCount);
+  std::printf("%-8s %16s %16s %9s\n", "samples", "glm", "batched", "speedup");
+  std::printf("%-8s %14.0f/s %14.0f/s %8.2fx\n", "", samples / glmSeconds, samples / batchSeconds,
+              glmSeconds / batchSeconds);
+  std::printf("%-8s %16s %16s %16s\n", "column", "glm", "NoiseGraph", "TerrainNoise");
+  std::printf("%-8s %14.1fus %14.1fus %14.1fus\n", "", columnSeconds[0] / columnCount * 1e6,
+              columnSeconds[1] / columnCount * 1e6, columnSeconds[2] / columnCount * 1e6);
+  std::printf("%-8s %16.2f %15.2fx %15.2fx\n", "speedup", 1.0, columnSeconds[0] / columnSeconds[1],
+              columnSeconds[0] / columnSeconds[2]);
+  bool matching = maxError <= SIMPLEX_TOLERANCE && graphMismatches == 0;
+  std::printf("max sample error %g, tolerance %g\n", maxError, SIMPLEX_TOLERANCE);
+  std::printf("max height error against glm %g voxels, %zu values differ between the graphs\n", maxHeightError,
+              graphMismatches);
+  return matching ? 0 : 1;
+}
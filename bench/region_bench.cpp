@@ -0,0 +1,151 @@
+// Headless region file benchmark: generates a region of terrain chunks the way World does,
+// saves them to a region file and loads them back, reporting chunks per second for noise
+// generation against loading and the compression ratio on disk.
+//
+//   ZenixRegionBench [columns] [layers] [repetitions]
+
+#include "defines.hpp"
+#include "region_file.hpp"
+#include "voxel.hpp"
+#include "voxel_palette.hpp"
+
+#include <glm/gtc/noise.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <vector>
+
+using namespace zx;
+
+namespace {
+
+double secondsSince(std::chrono::high_resolution_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// the fractal simplex sum of World's getNoiseAt
+float fractal(float x, float z, int octaves, float smoothness, float roughness) {
+  float value = 0.f;
+  float total = 0.f;
+  for (int i = 0; i < octaves; i++) {
+    float frequency = static_cast<float>(1 << i);
+    float amplitude = std::pow(roughness, static_cast<float>(i));
+    value += amplitude * (glm::simplex(glm::vec3{x * frequency / smoothness, z * frequency / smoothness, 0.f}) + 1.f) / 2.f;
+    total += amplitude;
+  }
+  return value / total;
+}
+
+// what a World generation job does for one chunk
+void generate(const glm::ivec3& chunkPos, Voxel* voxels, PalettedVoxels& out) {
+  std::array<int, CHUNK_AREA> heights;
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      float wx = static_cast<float>(chunkPos.x * CHUNK_SIZE + x);
+      float wz = static_cast<float>(chunkPos.z * CHUNK_SIZE + z);
+      float noise = fractal(wx, wz, 6, 205.f, 0.58f) * fractal(wx, wz, 4, 200.f, 0.45f);
+      heights[z * CHUNK_SIZE + x] = static_cast<int>(noise * 105.f + 18.f);
+    }
+  }
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      for (int x = 0; x < CHUNK_SIZE; x++) {
+        int height = heights[z * CHUNK_SIZE + x];
+        int voxel_y = chunkPos.y * CHUNK_SIZE + y;
+        Voxel voxel = voxel_y > height ? (voxel_y < WATER_LEVEL ? water : air) : voxel_y == height ? grass : stone;
+        voxels[voxelIndex(x, y, z)] = voxel;
+      }
+    }
+  }
+  out.encode(voxels);
+}
+
+}
+
+int main(int argc, char** argv) {
+  // a full region by default
+  int columns = argc > 1 ? std::atoi(argv[1]) : RegionFile::REGION_SIZE;
+  int layers = argc > 2 ? std::atoi(argv[2]) : 4;
+  int repetitions = argc > 3 ? std::atoi(argv[3]) : 5;
+  columns = std::clamp(columns, 1, RegionFile::REGION_SIZE);
+  layers = std::max(layers, 1);
+  repetitions = std::max(repetitions, 1);
+
+  std::vector<glm::ivec3> positions;
+  for (int z = 0; z < columns; z++) {
+    for (int x = 0; x < columns; x++) {
+      for (int y = 0; y < layers; y++) {
+        positions.push_back({x, y, z});
+      }
+    }
+  }
+  double chunkCount = static_cast<double>(positions.size());
+  std::printf("%zu chunks, %d repetitions\n", positions.size(), repetitions);
+
+  std::vector<PalettedVoxels> generated(positions.size());
+  std::vector<Voxel> voxels(CHUNK_VOLUME);
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t c = 0; c < positions.size(); c++) {
+    generate(positions[c], voxels.data(), generated[c]);
+  }
+  double generateSeconds = secondsSince(start);
+
+  std::filesystem::path directory = std::filesystem::temp_directory_path() / "zenix_region_bench";
+  std::filesystem::path path = directory / "r.0.0.zxr";
+  std::filesystem::remove(path);
+
+  size_t rawBytes = 0;
+  start = std::chrono::high_resolution_clock::now();
+  {
+    RegionFile region{path.string()};
+    for (size_t c = 0; c < positions.size(); c++) {
+      region.writeChunk(positions[c], generated[c]);
+      rawBytes += generated[c].serializedSize();
+    }
+    region.flush();
+  }
+  double saveSeconds = secondsSince(start);
+
+  size_t fileBytes = 0;
+  size_t mismatches = 0;
+  double loadSeconds = 0.0;
+  {
+    // a fresh mapping, as after a restart
+    RegionFile region{path.string()};
+    PalettedVoxels loaded;
+    std::vector<Voxel> expected(CHUNK_VOLUME);
+    for (size_t c = 0; c < positions.size(); c++) {
+      if (!region.readChunk(positions[c], loaded)) {
+        mismatches++;
+        continue;
+      }
+      loaded.decode(voxels.data());
+      generated[c].decode(expected.data());
+      mismatches += voxels != expected;
+    }
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repetitions; r++) {
+      for (const glm::ivec3& position : positions) {
+        region.readChunk(position, loaded);
+      }
+    }
+    loadSeconds = secondsSince(start) / repetitions;
+    fileBytes = region.fileSize();
+  }
+
+  std::printf("%-10s %14s\n", "step", "chunks/s");
+  std::printf("%-10s %14.0f\n", "generate", chunkCount / generateSeconds);
+  std::printf("%-10s %14.0f\n", "save", chunkCount / saveSeconds);
+  std::printf("%-10s %14.0f\n", "load", chunkCount / loadSeconds);
+  std::printf("%zu bytes packed, %zu bytes on disk, %.1fx smaller, %zu mismatches\n", rawBytes, fileBytes,
+              static_cast<double>(rawBytes) / static_cast<double>(fileBytes), mismatches);
+
+  std::filesystem::remove_all(directory);
+  return mismatches == 0 ? 0 : 1;
+}
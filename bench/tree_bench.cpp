@@ -0,0 +1,148 @@
+// Headless voxel tree benchmark: generates a square of terrain chunk columns the way World's
+// generation jobs do and installs them into a VoxelTree one chunk at a time, as World does when
+// it keeps the tree. Reports the time per chunk of writeChunk against the fill per run of one
+// type along x it replaced, of reading a chunk back out, and of clearing it on unload.
+//
+//   ZenixTreeBench [columns] [repetitions]
+
+#include "defines.hpp"
+#include "terrain_generator.hpp"
+#include "voxel.hpp"
+#include "voxel_palette.hpp"
+#include "voxel_tree.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace zx;
+
+namespace {
+
+constexpr int LAYERS = TERRAIN_MAX_HEIGHT / CHUNK_SIZE + 1;
+// the depth World keeps its tree at
+constexpr int DEPTH = 5;
+
+double secondsSince(std::chrono::high_resolution_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// how writeChunk used to go in, a fill per run of one type along x
+void writeRuns(VoxelTree& tree, const glm::ivec3& chunkPos, const PalettedVoxels& voxels) {
+  glm::ivec3 chunkMin = chunkPos * CHUNK_SIZE;
+  if (voxels.isUniform()) {
+    tree.fill(chunkMin, chunkMin + CHUNK_SIZE, voxels.get(0));
+    return;
+  }
+  std::array<Voxel, CHUNK_VOLUME> decoded;
+  voxels.decode(decoded.data());
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      for (int x = 0; x < CHUNK_SIZE;) {
+        Voxel voxel = decoded[voxelIndex(x, y, z)];
+        int end = x + 1;
+        while (end < CHUNK_SIZE && decoded[voxelIndex(end, y, z)] == voxel) {
+          end++;
+        }
+        tree.fill(chunkMin + glm::ivec3{x, y, z}, chunkMin + glm::ivec3{end, y + 1, z + 1}, voxel);
+        x = end;
+      }
+    }
+  }
+}
+
+struct Timing {
+  double total = 0.0;
+  double worst = 0.0;
+};
+
+// the tree is cleared between repetitions the way unloads clear it, which is timed as well
+template <typename Write>
+Timing install(const std::vector<glm::ivec3>& positions, const std::vector<PalettedVoxels>& generated,
+               int repetitions, Write write, Timing& unload) {
+  Timing timing;
+  VoxelTree tree{DEPTH};
+  for (int r = 0; r < repetitions; r++) {
+    for (size_t c = 0; c < positions.size(); c++) {
+      auto start = std::chrono::high_resolution_clock::now();
+      write(tree, positions[c], generated[c]);
+      double seconds = secondsSince(start);
+      timing.total += seconds;
+      timing.worst = std::max(timing.worst, seconds);
+    }
+    for (const glm::ivec3& position : positions) {
+      glm::ivec3 chunkMin = position * CHUNK_SIZE;
+      auto start = std::chrono::high_resolution_clock::now();
+      tree.fill(chunkMin, chunkMin + CHUNK_SIZE, air);
+      double seconds = secondsSince(start);
+      unload.total += seconds;
+      unload.worst = std::max(unload.worst, seconds);
+    }
+  }
+  return timing;
+}
+
+}
+
+int main(int argc, char** argv) {
+  int columns = argc > 1 ? std::atoi(argv[1]) : 16;
+  int repetitions = argc > 2 ? std::atoi(argv[2]) : 5;
+  columns = std::max(columns, 1);
+  repetitions = std::max(repetitions, 1);
+
+  TerrainGenerator terrain{1234, 0};
+  std::vector<glm::ivec3> positions;
+  std::vector<PalettedVoxels> generated(static_cast<size_t>(columns * columns * LAYERS));
+  for (int z = 0; z < columns; z++) {
+    for (int x = 0; x < columns; x++) {
+      TerrainGenerator::HeightMap heights;
+      terrain.heightMap({x, z}, heights);
+      for (int y = 0; y < LAYERS; y++) {
+        terrain.fillChunk({x, y, z}, heights, generated[positions.size()]);
+        positions.push_back({x, y, z});
+      }
+    }
+  }
+  double chunkCount = static_cast<double>(positions.size()) * repetitions;
+  std::printf("%zu chunks, %d repetitions\n", positions.size(), repetitions);
+
+  Timing runsUnload;
+  Timing runs = install(positions, generated, repetitions, writeRuns, runsUnload);
+  Timing unload;
+  Timing bottomUp = install(
+      positions, generated, repetitions,
+      [](VoxelTree& tree, const glm::ivec3& position, const PalettedVoxels& voxels) {
+        tree.writeChunk(position, voxels);
+      },
+      unload);
+
+  // both have to hold the same voxels
+  VoxelTree expected{DEPTH};
+  VoxelTree tree{DEPTH};
+  for (size_t c = 0; c < positions.size(); c++) {
+    writeRuns(expected, positions[c], generated[c]);
+    tree.writeChunk(positions[c], generated[c]);
+  }
+  size_t mismatches = 0;
+  std::array<Voxel, CHUNK_VOLUME> read;
+  std::array<Voxel, CHUNK_VOLUME> decoded;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t c = 0; c < positions.size(); c++) {
+    tree.readChunk(positions[c], read.data());
+    generated[c].decode(decoded.data());
+    mismatches += read != decoded;
+  }
+  double readSeconds = secondsSince(start);
+  mismatches += tree.nodeCount() != expected.nodeCount();
+
+  std::printf("%-12s %12s %12s\n", "step", "us/chunk", "worst us");
+  std::printf("%-12s %12.1f %12.1f\n", "fill runs", runs.total / chunkCount * 1e6, runs.worst * 1e6);
+  std::printf("%-12s %12.1f %12.1f\n", "writeChunk", bottomUp.total / chunkCount * 1e6, bottomUp.worst * 1e6);
+  std::printf("%-12s %12.1f %12s\n", "readChunk", readSeconds / static_cast<double>(positions.size()) * 1e6, "-");
+  std::printf("%-12s %12.1f %12.1f\n", "unload", unload.total / chunkCount * 1e6, unload.worst * 1e6);
+  std::printf("%zu nodes, %zu bytes, %zu mismatches\n", tree.nodeCount(), tree.memoryUsage(), mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
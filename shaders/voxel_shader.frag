@@ -1,6 +1,6 @@
 #version 450
 
-layout (location = 0) in vec3 frag_color;
+layout (location = 0) in vec4 frag_color;
 layout (location = 1) in vec3 frag_normal;
 
 layout (location = 0) out vec4 out_color;
@@ -22,8 +22,8 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 layout(set = 0, binding = 2) uniform sampler2D image;
 
 void main() {
-  if(abs((vec3(0.8f, 0.2f, 0.25f) - frag_color).x) < 0.05f) {
+  if(abs((vec3(0.8f, 0.2f, 0.25f) - frag_color.rgb).x) < 0.05f) {
     //discard;
   }
-  out_color = vec4(max(dot(normalize(vec3(-1.f, -1.f, -1.f)), frag_normal), 0.f) * frag_color, 1.f);
+  out_color = vec4(max(dot(normalize(vec3(-1.f, -1.f, -1.f)), frag_normal), 0.f) * frag_color.rgb, frag_color.a);
 }
\ No newline at end of file
@@ -1,10 +1,13 @@
 #version 450
 
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 color;
-layout (location = 2) in vec3 normal;
+// Vertex pulling, there are no vertex attributes. Each face is packed by Chunk::Face::pack:
+// bits 0-14 origin (5 bits per axis), 15-17 face, 18-22 width - 1, 23-27 height - 1, 28-31 voxel.
+// The shared quad index buffer makes gl_VertexIndex = face index * 4 + corner.
+layout(std430, set = 1, binding = 0) readonly buffer ChunkFaces {
+  uint faces[];
+} chunk;
 
-layout (location = 0) out vec3 frag_color;
+layout (location = 0) out vec4 frag_color;
 layout (location = 1) out vec3 frag_normal;
 
 layout(push_constant) uniform Push {
@@ -21,17 +24,54 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
   float dt;
 } ubo;
 
+// indexed by face, same order as voxel_normals in chunk.cpp
+const vec3 normals[6] = vec3[](
+  vec3(0.f, 0.f, -1.f), vec3(0.f, 0.f, 1.f), vec3(1.f, 0.f, 0.f),
+  vec3(-1.f, 0.f, 0.f), vec3(0.f, 1.f, 0.f), vec3(0.f, -1.f, 0.f));
+
+// corners of the unit quad of each face, scaled by the face size and wound so that
+// the {0, 1, 2, 0, 2, 3} index pattern gives two front facing triangles
+const vec3 corners[24] = vec3[](
+  vec3(1.f, 0.f, 0.f), vec3(0.f, 0.f, 0.f), vec3(0.f, 1.f, 0.f), vec3(1.f, 1.f, 0.f),  // north
+  vec3(0.f, 0.f, 1.f), vec3(1.f, 0.f, 1.f), vec3(1.f, 1.f, 1.f), vec3(0.f, 1.f, 1.f),  // south
+  vec3(1.f, 0.f, 1.f), vec3(1.f, 0.f, 0.f), vec3(1.f, 1.f, 0.f), vec3(1.f, 1.f, 1.f),  // east
+  vec3(0.f, 0.f, 0.f), vec3(0.f, 0.f, 1.f), vec3(0.f, 1.f, 1.f), vec3(0.f, 1.f, 0.f),  // west
+  vec3(1.f, 1.f, 0.f), vec3(0.f, 1.f, 0.f), vec3(0.f, 1.f, 1.f), vec3(1.f, 1.f, 1.f),  // top
+  vec3(1.f, 0.f, 1.f), vec3(0.f, 0.f, 1.f), vec3(0.f, 0.f, 0.f), vec3(1.f, 0.f, 0.f)); // bottom
+
+// axis the face normal points along, 0 = x, 1 = y, 2 = z
+const uint faceAxis[6] = uint[](2u, 2u, 0u, 0u, 1u, 1u);
+
+// indexed by the Voxel enum: air, stone, grass, sand, water. Alpha only matters for the
+// translucent stream, the opaque pipeline does not blend.
+const vec4 colors[5] = vec4[](
+  vec4(0.8f, 0.2f, 0.25f, 1.f), vec4(0.4f, 0.4f, 0.4f, 1.f), vec4(0.1f, 0.9f, 0.2f, 1.f),
+  vec4(0.8f, 0.8f, 0.1f, 1.f), vec4(0.2f, 0.4f, 0.8f, 0.6f));
+
 float rand(vec2 seed){
     return fract(sin(dot(seed, vec2(12.9898, 78.233))) * 43758.5453);
 }
 
 void main() {
+  uint data = chunk.faces[gl_VertexIndex >> 2];
+  uint corner = uint(gl_VertexIndex) & 3u;
+
+  vec3 origin = vec3(data & 31u, (data >> 5) & 31u, (data >> 10) & 31u);
+  uint face = (data >> 15) & 7u;
+  uint voxel = data >> 28;
+
+  uint d = faceAxis[face];
+  vec3 size = vec3(1.f);
+  size[(d + 1u) % 3u] = float(((data >> 18) & 31u) + 1u);
+  size[(d + 2u) % 3u] = float(((data >> 23) & 31u) + 1u);
+  vec3 position = corners[face * 4u + corner] * size + origin;
+
   vec4 positionWorld = push.modelMatrix /*to world space*/ * vec4(position.x, position.y, position.z, 1.f) /*NDC space*/;
   //               finally                        <--  then                      <--   first
   gl_Position = ubo.projection /*to screen space*/ * ubo.view /*to camera space*/ * positionWorld /*world space*/;
   gl_Position.y = -gl_Position.y;
-  frag_color = color;
-  frag_normal = normal;
+  frag_color = colors[min(voxel, 4u)];
+  frag_normal = normals[face];
 }
 
                               /*          NDC Space
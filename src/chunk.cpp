@@ -1,210 +1,312 @@
 #include "chunk.hpp"
 
-#include "zx_utils.hpp"
-#include "zx_model.hpp"
+#include "voxel_arena.hpp"
 
-#include <glm/gtc/noise.hpp>
+#include <array>
+#include <utility>
 
-#include <cassert>
-#include <cstring>
-#include <unordered_map>
-#include <iostream>
-
-#ifndef ENGINE_DIR
-#define ENGINE_DIR "../"
-#endif
+namespace zx {
+namespace {
+// the layer of faces that looks into the neighbour on that side
+int borderSlice(int face) {
+  return voxel_normals[face][face_axis[face]] > 0 ? CHUNK_SIZE - 1 : 0;
+}
 
-using Vertex = zx::Chunk::Vertex;
+// a uniform chunk is not decoded, of the neighbours only the layer facing the chunk
+ChunkVoxels decodeInto(VoxelScratch& scratch, const PalettedVoxels& voxels,
+                       const std::array<const PalettedVoxels*, 6>& neighbours) {
+  ChunkVoxels view;
+  if (voxels.isUniform()) {
+    view.uniform = voxels.get(0);
+  } else {
+    voxels.decode(scratch.decoded.data());
+    view.voxels = scratch.decoded.data();
+  }
+  for (int face = 0; face < 6; face++) {
+    if (neighbours[face] == nullptr) {
+      continue;
+    }
+    neighbours[face]->decodeLayer(face_axis[face], borderSlice(oppositeFace(face)), scratch.neighbours[face].data());
+    view.neighbours[face] = scratch.neighbours[face].data();
+  }
+  return view;
+}
+}
 
-namespace std {
-template <>
-struct hash<Vertex> {
-  size_t operator()(Vertex const &vertex) const {
-    size_t seed = 0;
-    zx::hashCombine(seed, vertex.position.x, vertex.position.y, vertex.position.z, vertex.color.x, vertex.color.y, vertex.color.z, vertex.normal.x, vertex.normal.y, vertex.normal.z);
-    return seed;
+ChunkVoxels ChunkSnapshot::decode() const {
+  std::array<const PalettedVoxels*, 6> neighbourVoxels;
+  for (int face = 0; face < 6; face++) {
+    neighbourVoxels[face] = neighbours[face].get();
   }
-};
+  return decodeInto(voxelScratch(), *voxels, neighbourVoxels);
 }
 
-namespace zx {
-Chunk::Chunk(ZxDevice& zxDevice) : zxDevice{zxDevice} {}
+Chunk::Chunk(ZxDevice& zxDevice) : zxDevice{zxDevice}, voxelData{std::make_shared<PalettedVoxels>()} {}
 
 Chunk::~Chunk() {}
 
-void Chunk::createVertexBuffers() {
-  vertexCount = static_cast<uint32_t>(vertices.size());
-  assert(vertexCount >= 3 && "Vertex count must be at least 3!");
-  VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-  uint32_t vertexSize = sizeof(vertices[0]);
+void Chunk::reset(const glm::ivec3& newPosition) {
+  position = newPosition;
+  clearVoxels();
+  mesher.clear();
+  dirtySlices = {};
+  gpuMeshed = false;
+  faceCount = 0;
+  indexCount = 0;
+  unsaved = false;
+  editQueued = false;
+  generateTicket = 0;
+  meshTicket = 0;
+}
+
+PalettedVoxels& Chunk::editVoxels() {
+  // only this thread hands out snapshots, so the count can drop under us but never rise
+  if (voxelData.use_count() > 1) {
+    voxelData = std::make_shared<PalettedVoxels>(*voxelData);
+  }
+  return *voxelData;
+}
 
-  ZxBuffer stagingBuffer{
-      zxDevice,
-      vertexSize,
-      vertexCount,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-  };
+void Chunk::clearVoxels() {
+  if (voxelData.use_count() > 1) {
+    voxelData = std::make_shared<PalettedVoxels>();
+  } else {
+    voxelData->fill(air);
+  }
+}
 
-  stagingBuffer.map();
-  for(int i = 0; i < vertices.size(); i++){
-    vec3_info("VERTICES", vertices[i].position);
+ChunkSnapshot Chunk::snapshot(const ChunkNeighbours& neighbours) const {
+  ChunkSnapshot result;
+  result.voxels = voxelData;
+  for (int face = 0; face < 6; face++) {
+    if (neighbours[face] != nullptr) {
+      result.neighbours[face] = neighbours[face]->voxelData;
+    }
   }
-  stagingBuffer.writeToBuffer((void *)vertices.data());
+  return result;
+}
+
+void Chunk::createFaceBuffers(uint32_t capacity) {
+  faceCapacity = capacity;
 
-  vertexBuffer = std::make_unique<ZxBuffer>(
+  // the frames in flight may still draw the old faces
+  zxDevice.retireBuffer(std::move(faceBuffer));
+  faceBuffer = std::make_unique<ZxBuffer>(
       zxDevice,
-      vertexSize,
-      vertexCount,
-      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      sizeof(Face),
+      faceCapacity,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-  zxDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+  faceBufferChanged = true;
 }
 
-void Chunk::createIndexBuffers() {
-  indexCount = static_cast<uint32_t>(indices.size());
-  hasIndexBuffer = indexCount > 0;
+void Chunk::freeBuffers() {
+  zxDevice.retireBuffer(std::move(faceBuffer));
+  zxDevice.retireBuffer(std::move(drawCommandBuffer));
+  faceCapacity = 0;
+  faceCount = 0;
+  indexCount = 0;
+}
 
-  if (!hasIndexBuffer) {
+void Chunk::writeFaces(uint32_t first) {
+  uint32_t count = faceCount - first;
+  if (count == 0) {
     return;
   }
+  uint32_t faceSize = sizeof(Face);
 
-  VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-  uint32_t indexSize = sizeof(indices[0]);
-
-  ZxBuffer stagingBuffer{
+  auto stagingBuffer = std::make_unique<ZxBuffer>(
       zxDevice,
-      indexSize,
-      indexCount,
+      faceSize,
+      count,
       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-  };
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  stagingBuffer->map();
+  stagingBuffer->writeToBuffer((void *)(mesher.faces.data() + first));
+
+  // lands before the next frame, the ones in flight keep drawing the old faces until then
+  VkBuffer dstBuffer = faceBuffer->getBuffer();
+  zxDevice.uploadBuffer(std::move(stagingBuffer), dstBuffer, faceSize * count, faceSize * first);
+}
+
+void Chunk::draw(VkCommandBuffer commandBuffer, MeshStream stream, uint32_t directions) {
+  if (faceCount == 0) {
+    return;
+  }
+  if (gpuMeshed) {
+    if (stream == MeshStream::opaque) {
+      vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffer->getBuffer(), 0, 1, sizeof(DrawCommand));
+    }
+    return;
+  }
+  const auto& streamFirst = mesher.directionFirst[static_cast<int>(stream)];
+  const auto& streamCount = mesher.directionCount[static_cast<int>(stream)];
+  // neighbouring directions are adjacent in the buffer, so they share one draw
+  uint32_t first = 0;
+  uint32_t count = 0;
+  for (int face = 0; face < 6; face++) {
+    if (!(directions & (1u << face)) || streamCount[face] == 0) {
+      continue;
+    }
+    if (count > 0 && first + count != streamFirst[face]) {
+      vkCmdDrawIndexed(commandBuffer, count * 6, 1, first * 6, 0, 0);
+      count = 0;
+    }
+    if (count == 0) {
+      first = streamFirst[face];
+    }
+    count += streamCount[face];
+  }
+  if (count > 0) {
+    vkCmdDrawIndexed(commandBuffer, count * 6, 1, first * 6, 0, 0);
+  }
+}
 
-  stagingBuffer.map();
-  for(int i = 0; i < indices.size(); i++){
-    info("INDICES", std::to_string(indices[i]));
+void Chunk::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout) {
+  if (faceCount == 0) {
+    return;
   }
-  stagingBuffer.writeToBuffer((void *)indices.data());
+  vkCmdBindDescriptorSets(
+      commandBuffer,
+      VK_PIPELINE_BIND_POINT_GRAPHICS,
+      pipelineLayout,
+      1,
+      1,
+      &faceDescriptorSet,
+      0,
+      nullptr);
+}
 
-  indexBuffer = std::make_unique<ZxBuffer>(
-      zxDevice,
-      indexSize,
-      indexCount,
-      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+bool Chunk::hasTranslucentFaces() const {
+  return !gpuMeshed && mesher.hasTranslucentFaces();
+}
+
+Voxel Chunk::getVoxel(int x, int y, int z) const {
+  if (x < 0 || x >= CHUNK_SIZE || y < 0 || y >= CHUNK_SIZE || z < 0 || z >= CHUNK_SIZE) {
+    return air;
+  }
+  return voxelData->get(x, y, z);
+}
 
-  (zxDevice).copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+Voxel Chunk::getVoxel(int x, int y, int z, const ChunkNeighbours& neighbours) const {
+  int face = x < 0 ? 3 : x >= CHUNK_SIZE ? 2 : y < 0 ? 5 : y >= CHUNK_SIZE ? 4 : z < 0 ? 0 : z >= CHUNK_SIZE ? 1 : -1;
+  if (face < 0) {
+    return voxelData->get(x, y, z);
+  }
+  if (neighbours[face] == nullptr) {
+    return air;
+  }
+  return neighbours[face]->getVoxel((x + CHUNK_SIZE) % CHUNK_SIZE, (y + CHUNK_SIZE) % CHUNK_SIZE, (z + CHUNK_SIZE) % CHUNK_SIZE);
 }
 
+ChunkVoxels Chunk::decodeVoxels(const ChunkNeighbours& neighbours) const {
+  std::array<const PalettedVoxels*, 6> neighbourVoxels;
+  for (int face = 0; face < 6; face++) {
+    neighbourVoxels[face] = neighbours[face] != nullptr ? neighbours[face]->voxelData.get() : nullptr;
+  }
+  return decodeInto(voxelScratch(), *voxelData, neighbourVoxels);
+}
 
+void Chunk::create_mesh(const ChunkVoxels& voxels){
+  SliceMasks slices;
+  slices.fill(ChunkMesher::ALL_SLICES);
+  remesh(slices, voxels);
+}
 
-void Chunk::draw(VkCommandBuffer commandBuffer) {
-  if (hasIndexBuffer) {
-    vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
-  } else {
-    vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
-  }
-}
-
-void Chunk::bind(VkCommandBuffer commandBuffer) {
-  VkBuffer buffers[] = {vertexBuffer->getBuffer()};
-  VkDeviceSize offsets[] = {0};
-  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-
-  if (hasIndexBuffer) {
-    vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
-  }
-}
-
-std::vector<VkVertexInputBindingDescription> Chunk::Vertex::getBindingDescriptions() {
-std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
-bindingDescriptions[0].binding = 0;
-bindingDescriptions[0].stride = sizeof(Vertex);
-bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-return bindingDescriptions;
-}
-
-std::vector<VkVertexInputAttributeDescription> Chunk::Vertex::getAttributeDescriptions() {
-std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
-
-attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)});
-attributeDescriptions.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)});
-attributeDescriptions.push_back({2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
-
-return attributeDescriptions;
-}
-
-void Chunk::create_mesh(glm::vec2 pos){
-  vertices.clear();
-  indices.clear();
-
-  static const float voxel_vertices[] = {
-  0, 0, 0,
-  1, 0, 0,
-  1, 1, 0,
-  0, 1, 0,
-
-  0, 0, 1,
-  1, 0, 1,
-  1, 1, 1,
-  0, 1, 1
-  };
-
-  static int sz_vv = sizeof(voxel_vertices)/sizeof(voxel_vertices[0]);
-
-  static const uint32_t voxel_indices[] = {
-  1, 0, 3, 1, 3, 2, // north (-z)
-  4, 5, 6, 4, 6, 7, // south (+z)
-  5, 1, 2, 5, 2, 6, // east (+x)
-  0, 4, 7, 0, 7, 3, // west (-x)
-  2, 3, 7, 2, 7, 6, // top (+y)
-  5, 4, 0, 5, 0, 1, // bottom (-y)
-  };  
-
-  static const glm::vec3 voxel_normals[] = { {0.f, 0.f, -1.f}, {0.f, 0.f, 1.f}, {1.f, 0.f, 0.f}, {-1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}, {0.f, -1.f, 0.f} };
-  static int sz_vn = sizeof(voxel_normals)/sizeof(voxel_normals[0]);
-  
-  static int sz_vi = sizeof(voxel_indices)/sizeof(voxel_indices[0]);
-
-  int j = 0;
-  for(int y = 0; y < CHUNK_SIZE; y++) {
-    for(int z = 0; z < CHUNK_SIZE; z++) {
-      for(int x = 0; x < CHUNK_SIZE; x++) {
-        for(int i = 0, k = 0; i < sz_vv; i+=3, i%6==0 ? k++ : k=k){
-          Vertex vertex;
-
-          float xx = voxel_vertices[i]+x;
-          float yy = voxel_vertices[i+1]+y;
-          float zz = voxel_vertices[i+2]+z;
-          vertex.position = { xx, yy, zz};
-          
-          glm::vec3 red = { 0.8f, 0.2f, 0.25f };
-          glm::vec3 gray = { 0.4f, 0.4f, 0.4f };
-          glm::vec3 green = { 0.1f, 0.9f, 0.2f };
-          glm::vec3 yellow = { 0.8f, 0.8f, 0.1f };
-          glm::vec3 border = { 0.2, 0.9f, 0.3f };
-          Voxel voxel = voxels[x + y * CHUNK_SIZE + z * CHUNK_SIZE * CHUNK_SIZE];
-          voxel = voxels[j];
-          vertex.color = voxel == stone ? gray : voxel == grass ? green : voxel == sand ? yellow : red;
-          if((x == 0 || x == (CHUNK_SIZE-1) || z == 0 || z == (CHUNK_SIZE-1)) && (vertex.color != red)){
-            vertex.color = border;
-          }
-
-          glm::vec3 vn = voxel_normals[k];
-          vertex.normal = vn;
-          
-          vertices.push_back(vertex);
-        }
-        for(int i = 0; i < sz_vi; i++){
-          indices.push_back(voxel_indices[i]+8*j);
-        }
-        j++;
-      } // x
-    } // z
-  } // y
-  
-  createVertexBuffers();
-  createIndexBuffers();
-}
-}
\ No newline at end of file
+void Chunk::setVoxel(int x, int y, int z, Voxel voxel){
+  editVoxels().set(x, y, z, voxel);
+  unsaved = true;
+
+  glm::ivec3 pos{x, y, z};
+  for(int face = 0; face < 6; face++){
+    int d = face_axis[face];
+    // the voxel's own face, and the face of the voxel behind it that looks at it
+    markDirty(face, pos[d]);
+    int behind = pos[d] - voxel_normals[face][d];
+    if(behind >= 0 && behind < CHUNK_SIZE){
+      markDirty(face, behind);
+    }
+  }
+}
+
+void Chunk::markDirty(int face, int slice){
+  dirtySlices[face] |= 1u << slice;
+}
+
+void Chunk::markBorderDirty(int face){
+  markDirty(face, borderSlice(face));
+}
+
+bool Chunk::isDirty() const {
+  for(uint32_t slices : dirtySlices){
+    if(slices != 0){
+      return true;
+    }
+  }
+  return false;
+}
+
+void Chunk::remeshDirty(const ChunkVoxels& voxels){
+  if(!isDirty()){
+    return;
+  }
+  SliceMasks slices = dirtySlices;
+  remesh(slices, voxels);
+}
+
+void Chunk::remesh(const SliceMasks& requested, const ChunkVoxels& voxels){
+  SliceMasks slices = requested;
+  if (gpuMeshed) {
+    // the layers do not hold what the compute shader emitted, so nothing can be kept
+    slices.fill(ChunkMesher::ALL_SLICES);
+    gpuMeshed = false;
+  }
+
+  uint32_t first_changed = mesher.remesh(slices, voxels);
+  for(int face = 0; face < 6; face++){
+    dirtySlices[face] &= ~slices[face];
+  }
+  uploadFaces(first_changed);
+}
+
+void Chunk::applyMesh(ChunkMesher& meshed, const SliceMasks& slices, uint32_t first_changed){
+  std::swap(mesher, meshed);
+  mesher.meshing = meshed.meshing;
+  // edits made since the snapshot fail matches and are meshed again
+  for(int face = 0; face < 6; face++){
+    dirtySlices[face] &= ~slices[face];
+  }
+  gpuMeshed = false;
+  uploadFaces(first_changed);
+}
+
+bool Chunk::matches(const ChunkSnapshot& taken, const ChunkNeighbours& neighbours) const {
+  if (taken.voxels.get() != voxelData.get()) {
+    return false;
+  }
+  for (int face = 0; face < 6; face++) {
+    const PalettedVoxels* current = neighbours[face] != nullptr ? neighbours[face]->voxelData.get() : nullptr;
+    if (taken.neighbours[face].get() != current) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Chunk::uploadFaces(uint32_t first_changed){
+  faceCount = static_cast<uint32_t>(mesher.faces.size());
+  indexCount = faceCount * 6;
+
+  if (faceCount == 0) {
+    // every face is hidden, keep the buffer around for later edits
+    return;
+  }
+  if (!faceBuffer || faceCount > faceCapacity) {
+    // a quarter of headroom, so edits that add a few faces can be patched into the same buffer
+    createFaceBuffers(faceCount + faceCount / 4);
+    first_changed = 0;
+  }
+  writeFaces(first_changed);
+}
+}
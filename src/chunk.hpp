@@ -1,6 +1,9 @@
 #pragma once
 
+#include "chunk_mesher.hpp"
 #include "defines.hpp"
+#include "voxel.hpp"
+#include "voxel_palette.hpp"
 #include "zx_device.hpp"
 #include "zx_buffer.hpp"
 
@@ -8,56 +11,144 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include <array>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
 namespace zx {
 
-enum Voxel{
-  air,
-  stone,
-  grass,
-  sand,
-  water
+class Chunk;
+// read-only views of the six face neighbours in face order, nullptr where nothing is loaded
+using ChunkNeighbours = std::array<const Chunk*, 6>;
+
+// The voxels of a chunk and of its face neighbours as they were when it was taken. Nothing in
+// it changes afterwards, so any thread can read it without locks while the chunks are edited.
+struct ChunkSnapshot {
+  std::shared_ptr<const PalettedVoxels> voxels;
+  // nullptr where nothing is loaded
+  std::array<std::shared_ptr<const PalettedVoxels>, 6> neighbours;
+
+  // same as Chunk::decodeVoxels
+  ChunkVoxels decode() const;
 };
 
+  // The GPU side of a chunk: owns its voxels, meshes them with a ChunkMesher and keeps
+  // the resulting faces uploaded.
   class Chunk {
     public:
-      struct Vertex {
-        glm::vec3 position{};
-        glm::vec3 color{};
-        glm::vec3 normal{};
-
-        static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-        static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
-
-        bool operator==(const Vertex &other) const {
-          return position == other.position && color == other.color && normal == other.normal;
-        }
+      using Face = ChunkMesher::Face;
+      using SliceMasks = ChunkMesher::SliceMasks;
+
+      // written by voxel_mesh.comp and drawn with vkCmdDrawIndexedIndirect,
+      // faceCount is every face found and may exceed the face buffer capacity
+      struct DrawCommand {
+        VkDrawIndexedIndirectCommand draw;
+        uint32_t faceCount;
       };
 
       Chunk(ZxDevice& zxDevice);
       ~Chunk();
 
-      void bind(VkCommandBuffer commandBuffer);
-      void draw(VkCommandBuffer commandBuffer);
-
-      void createVertexBuffers();
-      void createIndexBuffers();
-      void create_mesh(glm::vec2 pos);
-
-      std::vector<Voxel> voxels;
+      // Voxels are shared copy-on-write. A snapshot hands out the current voxels without copying
+      // them and the next edit copies them first if a snapshot still holds them. Snapshots are
+      // taken on the thread that edits the chunk and can then be read anywhere.
+      const PalettedVoxels& voxels() const { return *voxelData; }
+      PalettedVoxels& editVoxels();
+      // every voxel air, without copying what a snapshot still holds
+      void clearVoxels();
+      ChunkSnapshot snapshot(const ChunkNeighbours& neighbours) const;
+      // the current voxels, shared the way a snapshot shares them
+      std::shared_ptr<const PalettedVoxels> shareVoxels() const { return voxelData; }
+
+      // Empties the chunk for reuse at another position. The face buffer, draw command buffer,
+      // descriptor set and mesher capacity are kept, so a recycled chunk allocates nothing
+      // until it needs more faces than it had before.
+      void reset(const glm::ivec3& position);
+
+      // binds the face storage buffer as set 1, the quad index buffer is shared by every chunk
+      void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+      // bit f of directions selects the faces looking along voxel_normals[f]. GPU meshed chunks
+      // are not sorted by stream or direction and draw everything with the opaque stream.
+      void draw(VkCommandBuffer commandBuffer, MeshStream stream, uint32_t directions = ALL_DIRECTIONS);
+      static constexpr uint32_t ALL_DIRECTIONS = 0x3f;
+
+      // the old face buffer is retired, frames in flight may still draw from it
+      void createFaceBuffers(uint32_t capacity);
+      // Retires the face and draw command buffers, for chunks that sit unused. The descriptor
+      // set is kept and replaced once createFaceBuffers runs again, until then the chunk has
+      // no faces and is not drawn.
+      void freeBuffers();
+      void create_mesh(const ChunkVoxels& voxels);
+      // Takes over the faces a job meshed from a snapshot and uploads them from first_changed,
+      // meshed gets the old mesher back for reuse. The job rebuilt slices, either every layer of
+      // a cleared mesher or some layers of a copy of this one. Only valid while matches(the
+      // snapshot) holds.
+      void applyMesh(ChunkMesher& meshed, const SliceMasks& slices, uint32_t first_changed);
+      // whether the chunk and its neighbours still hold the voxels taken was made of
+      bool matches(const ChunkSnapshot& taken, const ChunkNeighbours& neighbours) const;
+
+      // Edits only mark the layers whose faces can change, so any number of edits in a frame
+      // cost one remeshDirty that rebuilds those layers and patches the face buffer in place.
+      void setVoxel(int x, int y, int z, Voxel voxel);
+      void markDirty(int face, int slice);
+      void markBorderDirty(int face);
+      bool isDirty() const;
+      const SliceMasks& dirtyLayers() const { return dirtySlices; }
+      void remeshDirty(const ChunkVoxels& voxels);
+
+      // voxels outside the chunk read as air
+      Voxel getVoxel(int x, int y, int z) const;
+      // one step outside the chunk reads from the face neighbour there, air if it is not loaded
+      Voxel getVoxel(int x, int y, int z, const ChunkNeighbours& neighbours) const;
+      // Decodes what the mesher reads, this chunk and the border layer of each neighbour, into
+      // a buffer owned by the calling thread. Valid until that thread decodes again. A uniform
+      // chunk is not decoded, the mesher then only looks at its borders.
+      ChunkVoxels decodeVoxels(const ChunkNeighbours& neighbours) const;
+
+      bool hasTranslucentFaces() const;
+
+      // in chunks, the game object translation is this times CHUNK_SIZE
+      glm::ivec3 position{};
+
+      // mesher.meshing is picked per chunk and takes effect on the next create_mesh
+      ChunkMesher mesher;
 
       ZxDevice& zxDevice;
 
-      std::unique_ptr<ZxBuffer> vertexBuffer;
-      uint32_t vertexCount;
-
-      bool hasIndexBuffer = false;
-      std::unique_ptr<ZxBuffer> indexBuffer;
-      uint32_t indexCount;
-
-      std::vector<Vertex> vertices{};
-      std::vector<uint32_t> indices{};
+      std::unique_ptr<ZxBuffer> faceBuffer;
+      uint32_t faceCapacity = 0;
+      // set while the faces on the GPU came from voxel_mesh.comp, the mesher layers are then stale
+      bool gpuMeshed = false;
+      std::unique_ptr<ZxBuffer> drawCommandBuffer;
+      // written by VoxelRenderSystem, which replaces it whenever faceBuffer has been recreated
+      VkDescriptorSet faceDescriptorSet = VK_NULL_HANDLE;
+      bool faceBufferChanged = false;
+
+      // drawn with the quad index buffer bound by VoxelRenderSystem
+      uint32_t indexCount = 0;
+
+      // faces emitted by the last create_mesh, air and hidden faces excluded
+      uint32_t faceCount = 0;
+
+      // set when the voxels were generated or edited after the last World::saveChunks
+      bool unsaved = false;
+      // set while the chunk is in World's list of edited chunks, so it goes in once
+      bool editQueued = false;
+
+      // the World jobs filling and meshing the chunk, 0 when none is in flight. A result
+      // whose ticket no longer matches was overtaken and is dropped.
+      uint64_t generateTicket = 0;
+      uint64_t meshTicket = 0;
+
+    private:
+      void remesh(const SliceMasks& slices, const ChunkVoxels& voxels);
+      // uploads faces from first onwards, the ones before it are already in the buffer
+      void writeFaces(uint32_t first);
+      // after mesher changed, grows the face buffer if needed and uploads from first_changed on
+      void uploadFaces(uint32_t first_changed);
+
+      SliceMasks dirtySlices{};
+      std::shared_ptr<PalettedVoxels> voxelData;
   };
-}
\ No newline at end of file
+}
@@ -0,0 +1,132 @@
+#include "chunk_map.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace zx {
+
+uint32_t ChunkMap::hash(const glm::ivec3& position) {
+  uint32_t h = static_cast<uint32_t>(position.x) * 0x8da6b343u ^ static_cast<uint32_t>(position.y) * 0xd8163841u ^
+               static_cast<uint32_t>(position.z) * 0xcb1ab31fu;
+  // the table is indexed by the low bits, mix the high ones into them
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  return h;
+}
+
+size_t ChunkMap::probe(const glm::ivec3& position) const {
+  size_t mask = slots.size() - 1;
+  size_t slot = hash(position) & mask;
+  while (slots[slot].object != EMPTY && slots[slot].position != position) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+Chunk* ChunkMap::find(const glm::ivec3& position) const {
+  if (slots.empty()) {
+    return nullptr;
+  }
+  const Slot& slot = slots[probe(position)];
+  return slot.object != EMPTY ? objects[slot.object]->chunk.get() : nullptr;
+}
+
+ChunkNeighbours ChunkMap::neighbours(const glm::ivec3& position) const {
+  ChunkNeighbours neighbours;
+  for (int face = 0; face < 6; face++) {
+    neighbours[face] = find(position + voxel_normals[face]);
+  }
+  return neighbours;
+}
+
+Chunk& ChunkMap::insert(std::unique_ptr<ZxGameObject> chunkObject) {
+  if ((live + 1) * 2 > slots.size()) {
+    rehash(std::max<size_t>(16, slots.size() * 2));
+  }
+  glm::ivec3 position = chunkObject->chunk->position;
+  Slot& slot = slots[probe(position)];
+  if (slot.object != EMPTY) {
+    panic("a chunk is already loaded at " + std::to_string(position.x) + ", " + std::to_string(position.y) + ", " +
+          std::to_string(position.z));
+  }
+  slot = Slot{position, static_cast<uint32_t>(objects.size())};
+  objects.push_back(std::move(chunkObject));
+  live++;
+  return *objects.back()->chunk;
+}
+
+std::unique_ptr<ZxGameObject> ChunkMap::erase(const glm::ivec3& position) {
+  if (slots.empty()) {
+    return nullptr;
+  }
+  size_t hole = probe(position);
+  if (slots[hole].object == EMPTY) {
+    return nullptr;
+  }
+  uint32_t index = slots[hole].object;
+
+  // Backward shift instead of tombstones: later slots of the same run move into the hole unless
+  // their home slot lies between the hole and where they are, so no probe sequence is broken.
+  size_t mask = slots.size() - 1;
+  for (size_t next = (hole + 1) & mask; slots[next].object != EMPTY; next = (next + 1) & mask) {
+    size_t home = hash(slots[next].position) & mask;
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      slots[hole] = slots[next];
+      hole = next;
+    }
+  }
+  slots[hole].object = EMPTY;
+
+  // the moved from pointer is the tombstone
+  std::unique_ptr<ZxGameObject> chunkObject = std::move(objects[index]);
+  live--;
+  return chunkObject;
+}
+
+void ChunkMap::compact(size_t& cursor) {
+  if (live == objects.size()) {
+    return;
+  }
+  size_t kept = 0;
+  // past the end when the cursor was
+  size_t movedCursor = live;
+  for (size_t index = 0; index < objects.size(); index++) {
+    if (index == cursor) {
+      movedCursor = kept;
+    }
+    if (!objects[index]) {
+      continue;
+    }
+    objects[kept] = std::move(objects[index]);
+    slots[probe(objects[kept]->chunk->position)].object = static_cast<uint32_t>(kept);
+    kept++;
+  }
+  objects.resize(kept);
+  cursor = movedCursor;
+}
+
+void ChunkMap::reserve(size_t count) {
+  objects.reserve(count);
+  size_t slotCount = std::max<size_t>(16, slots.size());
+  while (count * 2 > slotCount) {
+    slotCount *= 2;
+  }
+  if (slotCount != slots.size()) {
+    rehash(slotCount);
+  }
+}
+
+void ChunkMap::rehash(size_t slotCount) {
+  slots.assign(slotCount, Slot{glm::ivec3{0}, EMPTY});
+  for (uint32_t index = 0; index < objects.size(); index++) {
+    // tombstones are only in objects, not in the table
+    if (!objects[index]) {
+      continue;
+    }
+    glm::ivec3 position = objects[index]->chunk->position;
+    slots[probe(position)] = Slot{position, index};
+  }
+}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "chunk.hpp"
+#include "zx_game_object.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace zx {
+
+// The loaded chunk objects of a world by chunk position. The objects sit in one vector, so
+// iterating them is a walk over contiguous pointers in insertion order, which does not depend on
+// hashing. Lookups go through an open addressing table of positions and vector indices with
+// linear probing, kept at most half full so a miss ends within a few slots. A chunk is keyed by
+// its Chunk::position, which must not change while it is in the map.
+//
+// Erase leaves a null tombstone in the vector, so the chunks after it keep their index and a
+// walk over the map that spans many frames, like World's unload sweep, neither skips nor repeats
+// a chunk across erases. compact drops the tombstones between such walks without reordering the
+// rest. Loops over the map must not insert or erase.
+class ChunkMap {
+ public:
+  using Objects = std::vector<std::unique_ptr<ZxGameObject>>;
+
+  // walks the chunk objects in insertion order, skipping tombstones
+  class Iterator {
+   public:
+    Iterator(Objects::const_iterator at, Objects::const_iterator end) : at{at}, end{end} { skip(); }
+    const std::unique_ptr<ZxGameObject>& operator*() const { return *at; }
+    Iterator& operator++() {
+      ++at;
+      skip();
+      return *this;
+    }
+    bool operator==(const Iterator& other) const { return at == other.at; }
+    bool operator!=(const Iterator& other) const { return at != other.at; }
+
+   private:
+    void skip() {
+      while (at != end && !*at) {
+        ++at;
+      }
+    }
+
+    Objects::const_iterator at;
+    Objects::const_iterator end;
+  };
+
+  // nullptr when nothing is loaded at position
+  Chunk* find(const glm::ivec3& position) const;
+  bool contains(const glm::ivec3& position) const { return find(position) != nullptr; }
+  ChunkNeighbours neighbours(const glm::ivec3& position) const;
+
+  // appended to the iteration order, the position must not be taken yet
+  Chunk& insert(std::unique_ptr<ZxGameObject> chunkObject);
+  // hands the chunk object back, nullptr when nothing is loaded at position
+  std::unique_ptr<ZxGameObject> erase(const glm::ivec3& position);
+  // Drops the tombstones erase left, keeping the order of the rest. cursor is an index into the
+  // stored objects and is moved along to the same chunk, or the next one when its was erased.
+  void compact(size_t& cursor);
+  void reserve(size_t count);
+
+  // loaded chunks, tombstones not counted
+  size_t size() const { return live; }
+  bool empty() const { return live == 0; }
+  Iterator begin() const { return {objects.begin(), objects.end()}; }
+  Iterator end() const { return {objects.end(), objects.end()}; }
+
+  // Stored objects by index, the loaded ones in insertion order with the tombstones since the
+  // last compact among them as nullptr. For walks that pause between frames.
+  size_t storedCount() const { return objects.size(); }
+  const ZxGameObject* stored(size_t index) const { return objects[index].get(); }
+
+ private:
+  static constexpr uint32_t EMPTY = UINT32_MAX;
+
+  struct Slot {
+    glm::ivec3 position;
+    // index into objects, EMPTY for a free slot
+    uint32_t object;
+  };
+
+  static uint32_t hash(const glm::ivec3& position);
+  // the slot holding position, or the free slot that ends its probe sequence
+  size_t probe(const glm::ivec3& position) const;
+  void rehash(size_t slotCount);
+
+  // a power of two in size, empty until the first insert
+  std::vector<Slot> slots;
+  Objects objects;
+  size_t live = 0;
+};
+}
@@ -0,0 +1,434 @@
+#include "chunk_mesher.hpp"
+
+#include "zx_utils.hpp"
+
+#include <array>
+#include <cstring>
+
+namespace zx {
+namespace {
+// corners of each face come from the table in voxel_shader.vert, wound so that
+// {0, 1, 2, 0, 2, 3} gives the two triangles
+const uint32_t quad_indices[] = { 0, 1, 2, 0, 2, 3 };
+
+// face looking down the negative and positive side of each axis
+const int negative_face[] = { 3, 5, 0 };
+const int positive_face[] = { 2, 4, 1 };
+}
+
+const char* meshingStrategyName(MeshingStrategy strategy) {
+  switch (strategy) {
+    case MeshingStrategy::culled:
+      return "culled";
+    case MeshingStrategy::greedy:
+      return "greedy";
+    case MeshingStrategy::binary:
+      return "binary";
+    case MeshingStrategy::gpu:
+      return "gpu";
+  }
+  return "unknown";
+}
+
+Voxel ChunkVoxels::get(int x, int y, int z) const {
+  int face = x < 0 ? 3 : x >= CHUNK_SIZE ? 2 : y < 0 ? 5 : y >= CHUNK_SIZE ? 4 : z < 0 ? 0 : z >= CHUNK_SIZE ? 1 : -1;
+  if (face < 0) {
+    return voxels != nullptr ? voxels[voxelIndex(x, y, z)] : uniform;
+  }
+  const Voxel* neighbour = neighbours[face];
+  if (neighbour == nullptr) {
+    return air;
+  }
+  x = (x + CHUNK_SIZE) % CHUNK_SIZE;
+  y = (y + CHUNK_SIZE) % CHUNK_SIZE;
+  z = (z + CHUNK_SIZE) % CHUNK_SIZE;
+  return neighbour[voxelIndex(x, y, z)];
+}
+
+std::vector<uint32_t> ChunkMesher::quadIndices(uint32_t quadCount) {
+  std::vector<uint32_t> indices;
+  indices.reserve(quadCount * 6);
+  for(uint32_t quad = 0; quad < quadCount; quad++){
+    for(int i = 0; i < 6; i++){
+      indices.push_back(quad_indices[i] + quad * 4);
+    }
+  }
+  return indices;
+}
+
+bool ChunkMesher::hasTranslucentFaces() const {
+  for (uint32_t count : directionCount[static_cast<int>(MeshStream::translucent)]) {
+    if (count > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ChunkMesher::clear() {
+  for(auto& stream_layers : layers){
+    for(auto& face_layers : stream_layers){
+      for(auto& layer : face_layers){
+        layer.clear();
+      }
+    }
+  }
+  faces.clear();
+  for(auto& first : directionFirst){
+    first.fill(0);
+  }
+  for(auto& count : directionCount){
+    count.fill(0);
+  }
+}
+
+uint32_t ChunkMesher::remesh(const SliceMasks& slices, const ChunkVoxels& voxels){
+  // layers before the first rebuilt one keep their place,
+  // the buffer holds every opaque layer first and the translucent ones after
+  uint32_t first_changed = 0;
+  bool found_changed = false;
+  for(int stream = 0; stream < MESH_STREAMS && !found_changed; stream++){
+    for(int face = 0; face < 6 && !found_changed; face++){
+      for(int slice = 0; slice < CHUNK_SIZE; slice++){
+        if(slices[face] & (1u << slice)){
+          found_changed = true;
+          break;
+        }
+        first_changed += static_cast<uint32_t>(layers[stream][face][slice].size());
+      }
+    }
+  }
+
+  for(auto& stream_layers : layers){
+    for(int face = 0; face < 6; face++){
+      for(int slice = 0; slice < CHUNK_SIZE; slice++){
+        if(slices[face] & (1u << slice)){
+          stream_layers[face][slice].clear();
+        }
+      }
+    }
+  }
+
+  if (voxels.voxels == nullptr) {
+    meshUniform(slices, voxels);
+  } else {
+    switch (meshing) {
+      case MeshingStrategy::culled:
+      case MeshingStrategy::gpu:
+        // the CPU fallback for GPU meshed chunks, same faces as voxel_mesh.comp
+        meshCulled(slices, voxels);
+        break;
+      case MeshingStrategy::greedy:
+        meshGreedy(slices, voxels);
+        break;
+      case MeshingStrategy::binary:
+        meshBinary(slices, voxels);
+        break;
+    }
+  }
+
+  faces.resize(first_changed);
+  bool past_changed = false;
+  uint32_t first = 0;
+  for(int stream = 0; stream < MESH_STREAMS; stream++){
+    for(int face = 0; face < 6; face++){
+      directionFirst[stream][face] = first;
+      directionCount[stream][face] = 0;
+      for(int slice = 0; slice < CHUNK_SIZE; slice++){
+        const auto& layer = layers[stream][face][slice];
+        directionCount[stream][face] += static_cast<uint32_t>(layer.size());
+        past_changed = past_changed || (slices[face] & (1u << slice));
+        if(past_changed){
+          faces.insert(faces.end(), layer.begin(), layer.end());
+        }
+      }
+      first += directionCount[stream][face];
+    }
+  }
+  return first_changed;
+}
+
+void ChunkMesher::addQuad(int face, const glm::ivec3& origin, const glm::ivec3& size, Voxel voxel) {
+  int d = face_axis[face];
+  layers[static_cast<int>(meshStream(voxel))][face][origin[d]].push_back(Face::pack(origin, face, size[(d + 1) % 3], size[(d + 2) % 3], voxel));
+}
+
+void ChunkMesher::meshCulled(const SliceMasks& slices, const ChunkVoxels& voxels) {
+  for(int z = 0; z < CHUNK_SIZE; z++) {
+    for(int y = 0; y < CHUNK_SIZE; y++) {
+      for(int x = 0; x < CHUNK_SIZE; x++) {
+        Voxel voxel = voxels.voxels[voxelIndex(x, y, z)];
+        if(voxel == air){
+          continue;
+        }
+
+        glm::ivec3 pos{x, y, z};
+        for(int face = 0; face < 6; face++){
+          if(!(slices[face] & (1u << pos[face_axis[face]]))){
+            continue;
+          }
+          glm::ivec3 n = voxel_normals[face];
+          Voxel neighbour = voxels.get(x + n.x, y + n.y, z + n.z);
+          // a face is hidden by an opaque neighbour, or by more of the same (water against water)
+          if(isOpaque(neighbour) || neighbour == voxel){
+            continue;
+          }
+          addQuad(face, pos, {1, 1, 1}, voxel);
+        }
+      } // x
+    } // y
+  } // z
+}
+
+void ChunkMesher::meshGreedy(const SliceMasks& slices, const ChunkVoxels& voxels) {
+  // visible face type for every cell of the current slice, air where there is no face
+  std::array<Voxel, CHUNK_AREA> mask;
+
+  for(int face = 0; face < 6; face++){
+    glm::ivec3 n = voxel_normals[face];
+    int d = face_axis[face];
+    int u = (d + 1) % 3;
+    int v = (d + 2) % 3;
+
+    for(int slice = 0; slice < CHUNK_SIZE; slice++){
+      if(!(slices[face] & (1u << slice))){
+        continue;
+      }
+
+      glm::ivec3 pos;
+      pos[d] = slice;
+      for(int j = 0; j < CHUNK_SIZE; j++){
+        for(int i = 0; i < CHUNK_SIZE; i++){
+          pos[u] = i;
+          pos[v] = j;
+          Voxel voxel = voxels.voxels[voxelIndex(pos.x, pos.y, pos.z)];
+          Voxel neighbour = voxels.get(pos.x + n.x, pos.y + n.y, pos.z + n.z);
+          bool visible = voxel != air && !isOpaque(neighbour) && neighbour != voxel;
+          mask[i + j * CHUNK_SIZE] = visible ? voxel : air;
+        }
+      }
+
+      // grow each face into the widest run along u, then as many matching rows along v as possible
+      for(int j = 0; j < CHUNK_SIZE; j++){
+        for(int i = 0; i < CHUNK_SIZE;){
+          Voxel voxel = mask[i + j * CHUNK_SIZE];
+          if(voxel == air){
+            i++;
+            continue;
+          }
+
+          int w = 1;
+          while(i + w < CHUNK_SIZE && mask[i + w + j * CHUNK_SIZE] == voxel){
+            w++;
+          }
+
+          int h = 1;
+          for(; j + h < CHUNK_SIZE; h++){
+            bool row_matches = true;
+            for(int k = 0; k < w; k++){
+              if(mask[i + k + (j + h) * CHUNK_SIZE] != voxel){
+                row_matches = false;
+                break;
+              }
+            }
+            if(!row_matches){
+              break;
+            }
+          }
+
+          for(int l = 0; l < h; l++){
+            for(int k = 0; k < w; k++){
+              mask[i + k + (j + l) * CHUNK_SIZE] = air;
+            }
+          }
+
+          glm::ivec3 origin;
+          origin[d] = slice;
+          origin[u] = i;
+          origin[v] = j;
+          glm::ivec3 size{1, 1, 1};
+          size[u] = w;
+          size[v] = h;
+          addQuad(face, origin, size, voxel);
+
+          i += w;
+        }
+      }
+    }
+  }
+}
+
+void ChunkMesher::meshBinary(const SliceMasks& slices, const ChunkVoxels& voxels) {
+  // One column per (u, v) and axis, bit i + 1 holds cell i along the axis so that
+  // bits 0 and CHUNK_SIZE + 1 are the neighbour padding, copied from the adjacent chunks.
+  // Water is the only non-opaque solid, so it gets its own masks instead of one per type.
+  uint64_t opaque_cols[3][CHUNK_SIZE][CHUNK_SIZE] = {};
+  uint64_t translucent_cols[3][CHUNK_SIZE][CHUNK_SIZE] = {};
+  // one row mask per slice and voxel type, bit i is cell i along u
+  uint32_t planes[CHUNK_SIZE][VOXEL_TYPES][CHUNK_SIZE];
+
+  for(int z = 0; z < CHUNK_SIZE; z++) {
+    for(int y = 0; y < CHUNK_SIZE; y++) {
+      for(int x = 0; x < CHUNK_SIZE; x++) {
+        Voxel voxel = voxels.voxels[voxelIndex(x, y, z)];
+        if(voxel == air){
+          continue;
+        }
+        auto& cols = isOpaque(voxel) ? opaque_cols : translucent_cols;
+        cols[0][z][y] |= 1ull << (x + 1);
+        cols[1][x][z] |= 1ull << (y + 1);
+        cols[2][y][x] |= 1ull << (z + 1);
+      }
+    }
+  }
+
+  for(int d = 0; d < 3; d++){
+    int u = (d + 1) % 3;
+    int v = (d + 2) % 3;
+    const Voxel* below = voxels.neighbours[negative_face[d]];
+    const Voxel* above = voxels.neighbours[positive_face[d]];
+    for(int j = 0; j < CHUNK_SIZE; j++){
+      for(int i = 0; i < CHUNK_SIZE; i++){
+        glm::ivec3 pos;
+        pos[u] = i;
+        pos[v] = j;
+        if(below != nullptr){
+          pos[d] = CHUNK_SIZE - 1;
+          Voxel voxel = below[voxelIndex(pos.x, pos.y, pos.z)];
+          if(voxel != air){
+            (isOpaque(voxel) ? opaque_cols : translucent_cols)[d][j][i] |= 1ull;
+          }
+        }
+        if(above != nullptr){
+          pos[d] = 0;
+          Voxel voxel = above[voxelIndex(pos.x, pos.y, pos.z)];
+          if(voxel != air){
+            (isOpaque(voxel) ? opaque_cols : translucent_cols)[d][j][i] |= 1ull << (CHUNK_SIZE + 1);
+          }
+        }
+      }
+    }
+  }
+
+  for(int face = 0; face < 6; face++){
+    if(slices[face] == 0){
+      continue;
+    }
+    int d = face_axis[face];
+    int u = (d + 1) % 3;
+    int v = (d + 2) % 3;
+    bool positive = voxel_normals[face][d] > 0;
+
+    std::memset(planes, 0, sizeof(planes));
+
+    for(int j = 0; j < CHUNK_SIZE; j++){
+      for(int i = 0; i < CHUNK_SIZE; i++){
+        uint64_t opaque = opaque_cols[d][j][i];
+        uint64_t solid = opaque | translucent_cols[d][j][i];
+        // shift the neighbour in the face direction onto each cell
+        uint64_t opaque_next = positive ? opaque >> 1 : opaque << 1;
+        uint64_t solid_next = positive ? solid >> 1 : solid << 1;
+        // opaque faces show against anything non-opaque, water only against air
+        uint64_t faces = (opaque & ~opaque_next) | (solid & ~opaque & ~solid_next);
+        faces = (faces >> 1) & slices[face];
+
+        while(faces){
+          int slice = countTrailingZeros(faces);
+          faces &= faces - 1;
+          glm::ivec3 pos;
+          pos[d] = slice;
+          pos[u] = i;
+          pos[v] = j;
+          Voxel voxel = voxels.voxels[voxelIndex(pos.x, pos.y, pos.z)];
+          planes[slice][voxel][j] |= 1u << i;
+        }
+      }
+    }
+
+    for(int slice = 0; slice < CHUNK_SIZE; slice++){
+      if(!(slices[face] & (1u << slice))){
+        continue;
+      }
+      for(int type = 0; type < VOXEL_TYPES; type++){
+        addMergedQuads(face, slice, planes[slice][type], static_cast<Voxel>(type));
+      }
+    }
+  }
+}
+
+void ChunkMesher::meshUniform(const SliceMasks& slices, const ChunkVoxels& voxels) {
+  Voxel voxel = voxels.uniform;
+  if(voxel == air){
+    return;
+  }
+
+  for(int face = 0; face < 6; face++){
+    glm::ivec3 n = voxel_normals[face];
+    int d = face_axis[face];
+    int u = (d + 1) % 3;
+    int v = (d + 2) % 3;
+    int slice = n[d] > 0 ? CHUNK_SIZE - 1 : 0;
+    if(!(slices[face] & (1u << slice))){
+      continue;
+    }
+
+    uint32_t rows[CHUNK_SIZE] = {};
+    glm::ivec3 pos;
+    pos[d] = slice;
+    for(int j = 0; j < CHUNK_SIZE; j++){
+      for(int i = 0; i < CHUNK_SIZE; i++){
+        pos[u] = i;
+        pos[v] = j;
+        Voxel neighbour = voxels.get(pos.x + n.x, pos.y + n.y, pos.z + n.z);
+        if(!isOpaque(neighbour) && neighbour != voxel){
+          rows[j] |= 1u << i;
+        }
+      }
+    }
+
+    if(meshing == MeshingStrategy::greedy || meshing == MeshingStrategy::binary){
+      addMergedQuads(face, slice, rows, voxel);
+      continue;
+    }
+    for(int j = 0; j < CHUNK_SIZE; j++){
+      for(uint32_t row = rows[j]; row != 0; row &= row - 1){
+        pos[u] = countTrailingZeros(row);
+        pos[v] = j;
+        addQuad(face, pos, {1, 1, 1}, voxel);
+      }
+    }
+  }
+}
+
+void ChunkMesher::addMergedQuads(int face, int slice, uint32_t* rows, Voxel voxel) {
+  int d = face_axis[face];
+  int u = (d + 1) % 3;
+  int v = (d + 2) % 3;
+  for(int j = 0; j < CHUNK_SIZE; j++){
+    while(rows[j]){
+      uint32_t row = rows[j];
+      int i = countTrailingZeros(row);
+      // run length is the number of ones starting at i
+      uint32_t rest = ~(row >> i);
+      int w = rest ? countTrailingZeros(rest) : 32 - i;
+      uint32_t run = (w == 32 ? ~0u : (1u << w) - 1) << i;
+      rows[j] &= ~run;
+
+      int h = 1;
+      while(j + h < CHUNK_SIZE && (rows[j + h] & run) == run){
+        rows[j + h] &= ~run;
+        h++;
+      }
+
+      glm::ivec3 origin;
+      origin[d] = slice;
+      origin[u] = i;
+      origin[v] = j;
+      glm::ivec3 size{1, 1, 1};
+      size[u] = w;
+      size[v] = h;
+      addQuad(face, origin, size, voxel);
+    }
+  }
+}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "defines.hpp"
+#include "voxel.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace zx {
+
+// Voxels of one chunk, indexed by voxelIndex, and of its six
+// face neighbours in face order, nullptr where nothing is loaded.
+struct ChunkVoxels {
+  // nullptr for a chunk made of a single type, which is then uniform
+  const Voxel* voxels = nullptr;
+  Voxel uniform = air;
+  std::array<const Voxel*, 6> neighbours{};
+
+  // one step outside the chunk reads from the face neighbour there, air if it is not loaded
+  Voxel get(int x, int y, int z) const;
+};
+
+// Turns chunk voxels into packed faces on the CPU. Nothing here touches Vulkan, Chunk uploads
+// the result and the meshing benchmark runs it headless.
+class ChunkMesher {
+ public:
+  // One bit-packed quad, pulled from a storage buffer and expanded in voxel_shader.vert:
+  // bits 0-14 origin (5 bits per axis), 15-17 face, 18-22 width - 1, 23-27 height - 1, 28-31 voxel.
+  // Width runs along axis (d + 1) % 3 and height along (d + 2) % 3, d being the face axis.
+  struct Face {
+    uint32_t data{};
+
+    static Face pack(const glm::ivec3& origin, uint32_t face, uint32_t width, uint32_t height, Voxel voxel) {
+      return {static_cast<uint32_t>(origin.x) | static_cast<uint32_t>(origin.y) << 5 |
+              static_cast<uint32_t>(origin.z) << 10 | face << 15 | (width - 1) << 18 |
+              (height - 1) << 23 | static_cast<uint32_t>(voxel) << 28};
+    }
+
+    bool operator==(const Face &other) const {
+      return data == other.data;
+    }
+  };
+
+  static_assert(CHUNK_SIZE <= 32, "face origins and sizes are packed into 5 bits per axis");
+  static_assert(VOXEL_TYPES <= 16, "voxel types are packed into 4 bits");
+
+  // every voxel face at most once, the bound for the shared quad index buffer
+  static constexpr uint32_t MAX_QUADS = 6 * CHUNK_VOLUME;
+  // {0, 1, 2, 0, 2, 3} for each quad, offset by four vertices per quad, so gl_VertexIndex / 4
+  // is the face and gl_VertexIndex % 4 the corner
+  static std::vector<uint32_t> quadIndices(uint32_t quadCount);
+
+  // bit s of entry f selects the layer of face f quads at slice s along the face axis,
+  // which also needs CHUNK_SIZE <= 32
+  using SliceMasks = std::array<uint32_t, 6>;
+  static constexpr uint32_t ALL_SLICES = CHUNK_SIZE == 32 ? ~0u : (1u << CHUNK_SIZE) - 1;
+
+  // Rebuilds the selected layers and returns the index of the first face that changed,
+  // the faces before it are the same as after the previous call.
+  uint32_t remesh(const SliceMasks& slices, const ChunkVoxels& voxels);
+  bool hasTranslucentFaces() const;
+  // drops every face but keeps the allocations, for a mesher that moves to another chunk
+  void clear();
+
+  MeshingStrategy meshing = MeshingStrategy::binary;
+
+  // sorted by stream, then direction, then slice
+  std::vector<Face> faces{};
+  // faces of direction f in stream s start at directionFirst[s][f]
+  std::array<std::array<uint32_t, 6>, MESH_STREAMS> directionFirst{};
+  std::array<std::array<uint32_t, 6>, MESH_STREAMS> directionCount{};
+
+ private:
+  void meshCulled(const SliceMasks& slices, const ChunkVoxels& voxels);
+  void meshGreedy(const SliceMasks& slices, const ChunkVoxels& voxels);
+  void meshBinary(const SliceMasks& slices, const ChunkVoxels& voxels);
+  // a uniform chunk only has faces on its border layers, where the neighbour does not hide them
+  void meshUniform(const SliceMasks& slices, const ChunkVoxels& voxels);
+  // merges the set bits of rows, bit i of rows[j] being the face at (u = i, v = j), into
+  // rectangles and clears them
+  void addMergedQuads(int face, int slice, uint32_t* rows, Voxel voxel);
+  void addQuad(int face, const glm::ivec3& origin, const glm::ivec3& size, Voxel voxel);
+
+  // quads kept per stream, face and slice, so one layer can be rebuilt without the rest
+  std::array<std::array<std::array<std::vector<Face>, CHUNK_SIZE>, 6>, MESH_STREAMS> layers;
+};
+}
@@ -0,0 +1,33 @@
+#include "chunk_pool.hpp"
+
+namespace zx {
+
+ChunkPool::ChunkPool(ZxDevice& zxDevice) : zxDevice{zxDevice} {}
+
+std::unique_ptr<ZxGameObject> ChunkPool::acquire(const glm::ivec3& position) {
+  if (pool.empty()) {
+    return ZxGameObject::create_chunk_object(zxDevice, glm::vec3{position});
+  }
+  std::unique_ptr<ZxGameObject> chunkObject = std::move(pool.back());
+  pool.pop_back();
+  chunkObject->transform.translation = glm::vec3{position} * static_cast<float>(CHUNK_SIZE);
+  chunkObject->chunk->reset(position);
+  return chunkObject;
+}
+
+void ChunkPool::release(std::unique_ptr<ZxGameObject> chunkObject) {
+  // drop the voxels now rather than when the chunk is handed out again
+  chunkObject->chunk->clearVoxels();
+  if (pool.size() >= MAX_BUFFERED) {
+    chunkObject->chunk->freeBuffers();
+  }
+  pool.push_back(std::move(chunkObject));
+}
+
+void ChunkPool::reserve(size_t count) {
+  pool.reserve(count);
+  while (pool.size() < count) {
+    pool.push_back(ZxGameObject::create_chunk_object(zxDevice, glm::vec3{0.f}));
+  }
+}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "zx_device.hpp"
+#include "zx_game_object.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace zx {
+
+// Recycles chunk game objects. A released chunk keeps its Chunk, descriptor set, mesher capacity
+// and, while the pool is small, its face buffers. Its voxels go back to VoxelArena, so streaming
+// chunks in and out reuses the same objects instead of allocating new ones. Objects are never
+// destroyed, which also keeps the number of face descriptor sets at the most chunks ever loaded
+// at once.
+class ChunkPool {
+ public:
+  // Released chunks past this many free their GPU buffers, so unloading a wide ring of terrain
+  // gives the memory back instead of parking it in the pool.
+  static constexpr size_t MAX_BUFFERED = 64;
+
+  explicit ChunkPool(ZxDevice& zxDevice);
+
+  // a recycled chunk object reset to position (in chunks), a new one only when the pool is empty
+  std::unique_ptr<ZxGameObject> acquire(const glm::ivec3& position);
+  // the GPU must be done with the chunk, its buffers are handed out again
+  void release(std::unique_ptr<ZxGameObject> chunkObject);
+  // creates chunk objects up front, so the first ones streamed in do not allocate either
+  void reserve(size_t count);
+
+  size_t available() const { return pool.size(); }
+
+ private:
+  ZxDevice& zxDevice;
+  std::vector<std::unique_ptr<ZxGameObject>> pool;
+};
+}
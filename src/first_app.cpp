@@ -88,6 +88,10 @@ void FirstApp::run() {
   viewerObject.transform.rotation = {0.f, 0.f, 0.f};
   KeyboardMovementController cameraController{};
   float dt = 0.f;
+  MeshingStrategy meshingStrategy = MeshingStrategy::binary;
+  bool meshingKeyWasDown = false;
+  float meshingFrameTime = 0.f;
+  int meshingFrames = 0;
   auto currentTime = std::chrono::high_resolution_clock::now();
   while (!zxWindow.shouldClose()) {
     glfwPollEvents();
@@ -96,10 +100,42 @@ void FirstApp::run() {
     float frameTime =
         std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
     currentTime = newTime;
+    meshingFrameTime += frameTime;
+    meshingFrames++;
+
+    bool meshingKeyDown =
+        glfwGetKey(zxWindow.getGLFWwindow(), cameraController.keys.toggleMeshing) == GLFW_PRESS;
+    if (meshingKeyDown && !meshingKeyWasDown) {
+      std::cout << "Average frame time: " << meshingFrameTime / meshingFrames * 1000.f << " ms over "
+                << meshingFrames << " frames" << std::endl;
+      meshingStrategy = meshingStrategy == MeshingStrategy::binary ? MeshingStrategy::culled
+                        : meshingStrategy == MeshingStrategy::culled ? MeshingStrategy::greedy
+                        : meshingStrategy == MeshingStrategy::greedy ? MeshingStrategy::gpu
+                                                                     : MeshingStrategy::binary;
+      for (auto& world : worlds) {
+        world->setMeshingStrategy(meshingStrategy);
+      }
+      meshingFrameTime = 0.f;
+      meshingFrames = 0;
+    }
+    meshingKeyWasDown = meshingKeyDown;
+
+    for (auto& world : worlds) {
+      if (world->hasPendingEdits()) {
+        world->flushEdits();
+      }
+    }
 
     cameraController.moveInPlaneXZ(zxWindow.getGLFWwindow(), frameTime, viewerObject);
     camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
 
+    for (auto& world : worlds) {
+      world->updateStreaming(camera.getPosition());
+      if (world->hasPendingStreaming()) {
+        world->flushStreaming();
+      }
+    }
+
     float aspect = zxRenderer.getAspectRatio();
     camera.setPerspectiveProjection(glm::radians(60.0f), (float)zxWindow.getExtent().width / (float)zxWindow.getExtent().height, 0.1f, 512.0f);
     
@@ -141,9 +177,11 @@ void FirstApp::run() {
 
 
 void FirstApp::loadGameObjects() {
-  World world{zxDevice};
-  glm::vec2 pos = {0.f, 0.f};;
-  worlds[0]->generateTerrain(pos, 1);
+  // the view distance around the spawn on every core up front, World then streams the rest in
+  // around the camera every frame
+  for (auto& world : worlds) {
+    world->pregenerate({0, 0}, world->viewDistance);
+  }
 }
 
 }
\ No newline at end of file
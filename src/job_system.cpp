@@ -0,0 +1,113 @@
+#include "job_system.hpp"
+
+namespace zx {
+namespace {
+// set on worker threads, so a job submitted from one goes on that worker's own deque
+struct WorkerThread {
+  const JobSystem* system = nullptr;
+  size_t deque = 0;
+};
+thread_local WorkerThread currentWorker;
+}
+
+JobSystem::JobSystem(unsigned workerCount) {
+  for (unsigned i = 0; i <= workerCount; i++) {
+    deques.push_back(std::make_unique<Deque>());
+  }
+  threads.reserve(workerCount);
+  for (unsigned i = 0; i < workerCount; i++) {
+    threads.emplace_back([this, i] { workerLoop(i); });
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock{sleepMutex};
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+unsigned JobSystem::defaultWorkerCount() {
+  // at least one, a World never calls wait while streaming and would otherwise never run a job
+  unsigned hardwareThreads = std::thread::hardware_concurrency();
+  return hardwareThreads > 2 ? hardwareThreads - 1 : 1;
+}
+
+void JobSystem::submit(Job job) {
+  unfinished++;
+  size_t target = currentWorker.system == this ? currentWorker.deque : nextDeque++ % deques.size();
+  {
+    Deque& deque = *deques[target];
+    std::lock_guard<std::mutex> lock{deque.mutex};
+    deque.jobs.push_back(std::move(job));
+  }
+  queued++;
+  {
+    // a thread between checking queued and going to sleep would otherwise miss the notify
+    std::lock_guard<std::mutex> lock{sleepMutex};
+  }
+  wake.notify_one();
+}
+
+bool JobSystem::runOne(size_t own) {
+  Job job;
+  {
+    Deque& deque = *deques[own];
+    std::lock_guard<std::mutex> lock{deque.mutex};
+    if (!deque.jobs.empty()) {
+      job = std::move(deque.jobs.back());
+      deque.jobs.pop_back();
+    }
+  }
+  for (size_t i = 1; !job && i < deques.size(); i++) {
+    Deque& deque = *deques[(own + i) % deques.size()];
+    std::lock_guard<std::mutex> lock{deque.mutex};
+    if (!deque.jobs.empty()) {
+      job = std::move(deque.jobs.front());
+      deque.jobs.pop_front();
+    }
+  }
+  if (!job) {
+    return false;
+  }
+  queued--;
+  job();
+  finish();
+  return true;
+}
+
+void JobSystem::finish() {
+  if (--unfinished == 0) {
+    {
+      std::lock_guard<std::mutex> lock{sleepMutex};
+    }
+    wake.notify_all();
+  }
+}
+
+void JobSystem::workerLoop(unsigned index) {
+  currentWorker = {this, index};
+  while (!stopping) {
+    if (runOne(index)) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock{sleepMutex};
+    wake.wait(lock, [&] { return stopping || queued > 0; });
+  }
+}
+
+void JobSystem::wait() {
+  size_t own = deques.size() - 1;
+  while (unfinished > 0) {
+    if (runOne(own)) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock{sleepMutex};
+    wake.wait(lock, [&] { return unfinished == 0 || queued > 0; });
+  }
+}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace zx {
+
+// A fixed set of worker threads with a deque of jobs each. A worker takes the newest job off
+// its own deque and, once that is empty, steals the oldest one off another's, so jobs that
+// submit more jobs keep them on the same thread while idle workers spread the rest. Jobs are
+// coarse (a chunk each), so a mutex per deque costs nothing next to the work.
+//
+// The system makes no promise about which thread runs a job or in what order they finish.
+// Callers keep jobs free of shared state and put what they produce back in order themselves,
+// the way World applies results by the ticket handed out at submission, so that the outcome
+// does not depend on the number of workers.
+class JobSystem {
+ public:
+  using Job = std::function<void()>;
+
+  // 0 workers runs every job inside wait on the calling thread
+  explicit JobSystem(unsigned workerCount);
+  // jobs that have not started by now are dropped, wait first to run them
+  ~JobSystem();
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  // one worker per hardware thread but the one the caller of wait runs on, at least one
+  static unsigned defaultWorkerCount();
+
+  // From a worker the job goes on the back of its own deque, from anywhere else onto the
+  // deques in turn.
+  void submit(Job job);
+  // Runs jobs on the calling thread as well until every submitted job, including the ones
+  // submitted meanwhile, has finished. Not to be called from a job.
+  void wait();
+
+  unsigned workerCount() const { return static_cast<unsigned>(threads.size()); }
+
+ private:
+  struct Deque {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  void workerLoop(unsigned index);
+  // the newest job of deque own, or the oldest of another, false when every deque is empty
+  bool runOne(size_t own);
+  void finish();
+
+  // one per worker and one more shared by the threads that are not workers
+  std::vector<std::unique_ptr<Deque>> deques;
+  std::vector<std::thread> threads;
+  std::atomic<unsigned> nextDeque{0};
+  // jobs sitting in a deque, and jobs submitted but not finished
+  std::atomic<size_t> queued{0};
+  std::atomic<size_t> unfinished{0};
+  std::atomic<bool> stopping{false};
+  // idle workers and waiting callers sleep on this until a job is queued or the last one finishes
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+};
+}
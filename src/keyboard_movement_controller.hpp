@@ -18,6 +18,7 @@ class KeyboardMovementController {
     int lookRight = GLFW_KEY_RIGHT;
     int lookUp = GLFW_KEY_DOWN;
     int lookDown = GLFW_KEY_UP;
+    int toggleMeshing = GLFW_KEY_M;
   };
 
   void moveInPlaneXZ(GLFWwindow* window, float dt, ZxGameObject& gameObject);
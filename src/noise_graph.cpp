@@ -0,0 +1,40 @@
+#include "noise_graph.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace zx {
+
+NoiseGraph::NoiseGraph(std::vector<NoiseSettings> settings) : layers{std::move(settings)} {
+  for (const NoiseSettings& layer : layers) {
+    if (layer.octaves <= 0) {
+      panic("a noise layer needs at least one octave");
+    }
+    for (int octave = 0; octave < layer.octaves; octave++) {
+      terms.push_back(octaveTerm(layer, octave));
+    }
+  }
+}
+
+void NoiseGraph::sample(const glm::ivec2& column, int seed, NoiseColumn& out) const {
+  if (layers.empty()) {
+    panic("sampling a noise graph without layers");
+  }
+  out.fill(1.0f);
+  NoiseColumn layer;
+  size_t term = 0;
+  for (const NoiseSettings& settings : layers) {
+    layer.fill(0.5f);
+    for (int octave = 0; octave < settings.octaves; octave++) {
+      addOctave(column, seed, terms[term++], layer);
+    }
+    for (int i = 0; i < CHUNK_AREA; i++) {
+      out[i] *= layer[i];
+    }
+  }
+  for (float& value : out) {
+    value = value * layers[0].amplitude + layers[0].offset;
+  }
+}
+}
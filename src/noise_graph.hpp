@@ -0,0 +1,141 @@
+#pragma once
+
+#include "defines.hpp"
+#include "simplex_noise.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace zx {
+
+struct NoiseSettings {
+  int octaves;
+  float amplitude;
+  float smoothness;
+  float roughness;
+  float offset;
+};
+
+// one value per voxel column of a chunk column, z major like TerrainGenerator::HeightMap
+using NoiseColumn = std::array<float, CHUNK_AREA>;
+
+// One octave of a fractal sum with the normalisation folded in. The sum over the octaves of
+// (simplex + 1) / 2 * amplitude, divided by the sum of the amplitudes, is 0.5 plus the sum of
+// simplex * weight, and the frequency divided by the smoothness is a single scale.
+struct OctaveTerm {
+  float scale;
+  float weight;
+};
+
+// base to a whole power, by multiplication so it folds at compile time
+constexpr float noisePower(float base, int exponent) {
+  float result = 1.0f;
+  for (int i = 0; i < exponent; i++) {
+    result *= base;
+  }
+  return result;
+}
+
+constexpr OctaveTerm octaveTerm(const NoiseSettings& settings, int octave) {
+  float total = 0.0f;
+  for (int i = 0; i < settings.octaves; i++) {
+    total += noisePower(settings.roughness, i);
+  }
+  return {noisePower(2.0f, octave) / settings.smoothness, noisePower(settings.roughness, octave) / (2.0f * total)};
+}
+
+// Adds one octave at every voxel column of column. The seed shifts the samples in all three
+// axes, as it always has for terrain.
+inline void addOctave(const glm::ivec2& column, int seed, const OctaveTerm& term, NoiseColumn& out) {
+  // x only changes along a row and z only between rows, so one row of each covers the column
+  std::array<float, CHUNK_SIZE> rowX, rowZ;
+  for (int i = 0; i < CHUNK_SIZE; i++) {
+    rowX[i] = seed + (static_cast<float>(i) + static_cast<float>(column.x) * CHUNK_SIZE) * term.scale;
+    rowZ[i] = seed + (static_cast<float>(i) + static_cast<float>(column.y) * CHUNK_SIZE) * term.scale;
+  }
+  NoiseColumn x, y, noise;
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int vx = 0; vx < CHUNK_SIZE; vx++) {
+      x[z * CHUNK_SIZE + vx] = rowX[vx];
+      y[z * CHUNK_SIZE + vx] = rowZ[z];
+    }
+  }
+  simplexBatch(x.data(), y.data(), static_cast<float>(seed), noise.data(), CHUNK_AREA);
+  for (int i = 0; i < CHUNK_AREA; i++) {
+    out[i] += noise[i] * term.weight;
+  }
+}
+
+// The product of the fractal noise of each layer, times the amplitude of the first layer plus
+// its offset: how terrain heights are shaped. Built at runtime, so the settings can be tuned
+// without a rebuild. FixedNoiseGraph computes the same values with the settings known at compile
+// time, so a tuned graph can be baked in without the terrain changing.
+class NoiseGraph {
+ public:
+  NoiseGraph() = default;
+  explicit NoiseGraph(std::vector<NoiseSettings> layers);
+
+  bool empty() const { return layers.empty(); }
+  void sample(const glm::ivec2& column, int seed, NoiseColumn& out) const;
+
+  const std::vector<NoiseSettings>& settings() const { return layers; }
+
+ private:
+  std::vector<NoiseSettings> layers;
+  // the terms of every layer's octaves one after the other, worked out once
+  std::vector<OctaveTerm> terms;
+};
+
+// NoiseGraph with every layer fixed at compile time. The octaves of each layer unroll, their
+// terms are constants and nothing is left to divide by.
+//
+//   inline constexpr NoiseSettings SHAPE{6, 105.f, 205.f, 0.58f, 18.f};
+//   FixedNoiseGraph<SHAPE>::sample(column, seed, heights);
+template <const NoiseSettings&... Layers>
+class FixedNoiseGraph {
+ public:
+  static_assert(sizeof...(Layers) > 0, "a noise graph needs at least one layer");
+
+  static constexpr NoiseSettings FIRST = std::array<NoiseSettings, sizeof...(Layers)>{Layers...}[0];
+  static_assert(FIRST.amplitude >= 0.0f, "MAX assumes the layers are not flipped");
+  // The most sample returns. The weights of a layer's octaves add up to a half, so every layer
+  // lies between 0 and 1 and so does their product.
+  static constexpr float MAX = FIRST.amplitude + FIRST.offset;
+
+  static void sample(const glm::ivec2& column, int seed, NoiseColumn& out) {
+    out.fill(1.0f);
+    NoiseColumn layer;
+    (multiplyLayer<Layers>(column, seed, layer, out), ...);
+    for (float& value : out) {
+      value = value * FIRST.amplitude + FIRST.offset;
+    }
+  }
+
+ private:
+  template <const NoiseSettings& Settings>
+  static void multiplyLayer(const glm::ivec2& column, int seed, NoiseColumn& layer, NoiseColumn& out) {
+    static_assert(Settings.octaves > 0, "a noise layer needs at least one octave");
+    layer.fill(0.5f);
+    addOctaves<Settings>(column, seed, layer, std::make_integer_sequence<int, Settings.octaves>{});
+    for (int i = 0; i < CHUNK_AREA; i++) {
+      out[i] *= layer[i];
+    }
+  }
+
+  template <const NoiseSettings& Settings, int... Octaves>
+  static void addOctaves(const glm::ivec2& column, int seed, NoiseColumn& layer, std::integer_sequence<int, Octaves...>) {
+    (addOctave(column, seed, FixedTerm<Settings, Octaves>::TERM, layer), ...);
+  }
+
+  template <const NoiseSettings& Settings, int Octave>
+  struct FixedTerm {
+    static constexpr OctaveTerm TERM = octaveTerm(Settings, Octave);
+  };
+};
+}
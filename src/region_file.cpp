@@ -0,0 +1,440 @@
+#include "region_file.hpp"
+
+#include "voxel_arena.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace zx {
+namespace {
+constexpr char MAGIC[4] = {'Z', 'X', 'R', 'G'};
+constexpr uint32_t VERSION = 1;
+// chunks saved in one voxelIndex order do not load in the other
+constexpr uint32_t LAYOUT = std::is_same<VoxelLayout, MortonLayout>::value ? 1 : 0;
+constexpr size_t HEADER_SIZE = 16 + RegionFile::COLUMNS * 8;
+constexpr size_t SECTION_ENTRY_SIZE = 12;
+// the largest serialized chunk, 4 bits per voxel and a full palette
+constexpr size_t MAX_RAW_SIZE = 2 + PalettedVoxels::MAX_PALETTE + (CHUNK_VOLUME) / 2;
+static_assert(MAX_RAW_SIZE <= CHUNK_VOLUME, "a serialized chunk has to fit in voxelScratch().entries");
+
+int floorDiv(int a, int b) {
+  return a / b - (a % b < 0 ? 1 : 0);
+}
+
+uint32_t load32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 |
+         static_cast<uint32_t>(p[3]) << 24;
+}
+
+void store32(uint8_t* p, uint32_t value) {
+  p[0] = static_cast<uint8_t>(value);
+  p[1] = static_cast<uint8_t>(value >> 8);
+  p[2] = static_cast<uint8_t>(value >> 16);
+  p[3] = static_cast<uint8_t>(value >> 24);
+}
+
+// LZ4 block format: each sequence is a token with the literal count in its high and the match
+// length minus four in its low nibble, longer counts continued in bytes of 255, the literals, a
+// 16 bit offset back into the output and the match. The last sequence has literals only.
+// Packed indices are long runs of the same few bytes, which this shrinks several times over.
+constexpr size_t MIN_MATCH = 4;
+// the format wants the last five bytes as literals and no match starting in the last twelve
+constexpr size_t LAST_LITERALS = 5;
+constexpr size_t MATCH_LIMIT = 12;
+constexpr int HASH_BITS = 12;
+
+size_t compressBound(size_t size) {
+  return size + size / 255 + 16;
+}
+
+uint32_t read32(const uint8_t* p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+void writeLength(uint8_t*& out, size_t length) {
+  while (length >= 255) {
+    *out++ = 255;
+    length -= 255;
+  }
+  *out++ = static_cast<uint8_t>(length);
+}
+
+void writeLiterals(uint8_t*& out, uint8_t* token, const uint8_t* literals, size_t count) {
+  *token = static_cast<uint8_t>(std::min<size_t>(count, 15) << 4);
+  if (count >= 15) {
+    writeLength(out, count - 15);
+  }
+  std::memcpy(out, literals, count);
+  out += count;
+}
+
+// out needs compressBound(size) bytes, returns the compressed size
+size_t compress(const uint8_t* in, size_t size, uint8_t* out) {
+  uint8_t* op = out;
+  size_t anchor = 0;
+  if (size > MATCH_LIMIT) {
+    std::array<int32_t, 1 << HASH_BITS> table;
+    table.fill(-1);
+    size_t matchEnd = size - LAST_LITERALS;
+    for (size_t pos = 0; pos < size - MATCH_LIMIT;) {
+      uint32_t sequence = read32(in + pos);
+      uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+      int32_t candidate = table[hash];
+      table[hash] = static_cast<int32_t>(pos);
+      if (candidate < 0 || pos - candidate > 0xffff || read32(in + candidate) != sequence) {
+        pos++;
+        continue;
+      }
+      size_t length = MIN_MATCH;
+      while (pos + length < matchEnd && in[candidate + length] == in[pos + length]) {
+        length++;
+      }
+
+      uint8_t* token = op++;
+      writeLiterals(op, token, in + anchor, pos - anchor);
+      size_t offset = pos - candidate;
+      *op++ = static_cast<uint8_t>(offset);
+      *op++ = static_cast<uint8_t>(offset >> 8);
+      size_t extra = length - MIN_MATCH;
+      *token |= static_cast<uint8_t>(std::min<size_t>(extra, 15));
+      if (extra >= 15) {
+        writeLength(op, extra - 15);
+      }
+      pos += length;
+      anchor = pos;
+    }
+  }
+  uint8_t* token = op++;
+  writeLiterals(op, token, in + anchor, size - anchor);
+  return op - out;
+}
+
+// false when the block is malformed or does not inflate to exactly size bytes
+bool decompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t size) {
+  const uint8_t* ip = in;
+  const uint8_t* end = in + inSize;
+  uint8_t* op = out;
+  uint8_t* outEnd = out + size;
+  auto readLength = [&](size_t& length) {
+    uint8_t byte;
+    do {
+      if (ip == end) {
+        return false;
+      }
+      byte = *ip++;
+      length += byte;
+    } while (byte == 255);
+    return true;
+  };
+
+  while (ip < end) {
+    uint8_t token = *ip++;
+    size_t literals = token >> 4;
+    if (literals == 15 && !readLength(literals)) {
+      return false;
+    }
+    if (literals > static_cast<size_t>(end - ip) || literals > static_cast<size_t>(outEnd - op)) {
+      return false;
+    }
+    std::memcpy(op, ip, literals);
+    op += literals;
+    ip += literals;
+    if (ip == end) {
+      break;
+    }
+
+    if (end - ip < 2) {
+      return false;
+    }
+    size_t offset = ip[0] | ip[1] << 8;
+    ip += 2;
+    size_t length = token & 15;
+    if (length == 15 && !readLength(length)) {
+      return false;
+    }
+    length += MIN_MATCH;
+    if (offset == 0 || offset > static_cast<size_t>(op - out) || length > static_cast<size_t>(outEnd - op)) {
+      return false;
+    }
+    const uint8_t* match = op - offset;
+    if (offset >= length) {
+      std::memcpy(op, match, length);
+      op += length;
+    } else {
+      // the match overlaps what it writes, a run
+      for (size_t i = 0; i < length; i++) {
+        *op++ = *match++;
+      }
+    }
+  }
+  return op == outEnd;
+}
+
+// Calls visit(y, rawSize, compressed, compressedSize) for the sections of one column of a mapped
+// region until it returns true. Every offset and size comes from the file, so each one is checked
+// before it is followed.
+template <typename Visit>
+void forEachSection(const uint8_t* mapped, size_t mappedSize, int column, Visit visit) {
+  const uint8_t* entry = mapped + 16 + column * 8;
+  size_t offset = load32(entry);
+  size_t size = load32(entry + 4);
+  if (size < 4 || offset > mappedSize || size > mappedSize - offset) {
+    return;
+  }
+  const uint8_t* columnData = mapped + offset;
+  size_t count = load32(columnData);
+  if (count > (size - 4) / SECTION_ENTRY_SIZE) {
+    return;
+  }
+  size_t payload = 4 + count * SECTION_ENTRY_SIZE;
+  for (size_t s = 0; s < count; s++) {
+    const uint8_t* sectionEntry = columnData + 4 + s * SECTION_ENTRY_SIZE;
+    size_t compressedSize = load32(sectionEntry + 8);
+    if (compressedSize > size - payload) {
+      return;
+    }
+    if (visit(static_cast<int32_t>(load32(sectionEntry)), load32(sectionEntry + 4), columnData + payload,
+              compressedSize)) {
+      return;
+    }
+    payload += compressedSize;
+  }
+}
+}
+
+RegionFile::RegionFile(const std::string& path) : path{path} {
+  map();
+}
+
+RegionFile::~RegionFile() {
+  unmap();
+}
+
+glm::ivec2 RegionFile::regionOf(const glm::ivec3& chunkPos) {
+  return {floorDiv(chunkPos.x, REGION_SIZE), floorDiv(chunkPos.z, REGION_SIZE)};
+}
+
+int RegionFile::columnIndex(const glm::ivec3& chunkPos) {
+  int x = chunkPos.x - floorDiv(chunkPos.x, REGION_SIZE) * REGION_SIZE;
+  int z = chunkPos.z - floorDiv(chunkPos.z, REGION_SIZE) * REGION_SIZE;
+  return z * REGION_SIZE + x;
+}
+
+void RegionFile::map() {
+#if defined(_WIN32)
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size) && size.QuadPart >= static_cast<LONGLONG>(HEADER_SIZE)) {
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping != nullptr) {
+      // the view keeps the file mapped after both handles are closed
+      mapped = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+      mappedSize = mapped != nullptr ? static_cast<size_t>(size.QuadPart) : 0;
+      CloseHandle(mapping);
+    }
+  }
+  CloseHandle(file);
+#else
+  int file = open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    return;
+  }
+  struct stat status;
+  if (fstat(file, &status) == 0 && static_cast<size_t>(status.st_size) >= HEADER_SIZE) {
+    void* memory = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (memory != MAP_FAILED) {
+      mapped = static_cast<const uint8_t*>(memory);
+      mappedSize = static_cast<size_t>(status.st_size);
+    }
+  }
+  close(file);
+#endif
+  if (mapped == nullptr) {
+    return;
+  }
+  if (std::memcmp(mapped, MAGIC, sizeof(MAGIC)) != 0 || load32(mapped + 4) != VERSION ||
+      load32(mapped + 8) != LAYOUT) {
+    std::cout << "Ignoring region " << path << ", written by another version or voxel layout" << std::endl;
+    unmap();
+  }
+}
+
+void RegionFile::unmap() {
+  if (mapped == nullptr) {
+    return;
+  }
+#if defined(_WIN32)
+  UnmapViewOfFile(mapped);
+#else
+  munmap(const_cast<uint8_t*>(mapped), mappedSize);
+#endif
+  mapped = nullptr;
+  mappedSize = 0;
+}
+
+bool RegionFile::readChunk(const glm::ivec3& chunkPos, PalettedVoxels& voxels) const {
+  std::shared_lock<std::shared_mutex> lock{mutex};
+  int column = columnIndex(chunkPos);
+  auto staged = pending.find(column);
+  if (staged != pending.end()) {
+    for (const Section& section : staged->second) {
+      if (section.y == chunkPos.y) {
+        uint8_t* raw = voxelScratch().entries.data();
+        return decompress(section.compressed.data(), section.compressed.size(), raw, section.rawSize) &&
+               voxels.deserialize(raw, section.rawSize);
+      }
+    }
+    return false;
+  }
+  if (mapped == nullptr) {
+    return false;
+  }
+  bool found = false;
+  forEachSection(mapped, mappedSize, column,
+                 [&](int32_t y, uint32_t rawSize, const uint8_t* compressed, size_t compressedSize) {
+                   if (y != chunkPos.y) {
+                     return false;
+                   }
+                   uint8_t* raw = voxelScratch().entries.data();
+                   found = rawSize <= MAX_RAW_SIZE && decompress(compressed, compressedSize, raw, rawSize) &&
+                           voxels.deserialize(raw, rawSize);
+                   return true;
+                 });
+  return found;
+}
+
+std::vector<RegionFile::Section> RegionFile::mappedColumn(int column) const {
+  std::vector<Section> sections;
+  if (mapped == nullptr) {
+    return sections;
+  }
+  forEachSection(mapped, mappedSize, column,
+                 [&](int32_t y, uint32_t rawSize, const uint8_t* compressed, size_t compressedSize) {
+                   sections.push_back({y, rawSize, std::vector<uint8_t>(compressed, compressed + compressedSize)});
+                   return false;
+                 });
+  return sections;
+}
+
+void RegionFile::compress(const PalettedVoxels& voxels, CompressedChunk& out) {
+  uint8_t* raw = voxelScratch().entries.data();
+  size_t rawSize = voxels.serializedSize();
+  voxels.serialize(raw);
+  out.rawSize = static_cast<uint32_t>(rawSize);
+  out.bytes.resize(compressBound(rawSize));
+  out.bytes.resize(zx::compress(raw, rawSize, out.bytes.data()));
+}
+
+void RegionFile::writeChunk(const glm::ivec3& chunkPos, const PalettedVoxels& voxels) {
+  CompressedChunk chunk;
+  compress(voxels, chunk);
+  writeCompressed(chunkPos, chunk);
+}
+
+void RegionFile::writeCompressed(const glm::ivec3& chunkPos, CompressedChunk& chunk) {
+  std::unique_lock<std::shared_mutex> lock{mutex};
+  int column = columnIndex(chunkPos);
+  auto staged = pending.find(column);
+  if (staged == pending.end()) {
+    staged = pending.emplace(column, mappedColumn(column)).first;
+  }
+
+  std::vector<Section>& sections = staged->second;
+  auto section = std::find_if(sections.begin(), sections.end(),
+                              [&](const Section& s) { return s.y == chunkPos.y; });
+  if (section == sections.end()) {
+    sections.push_back({chunkPos.y, chunk.rawSize, std::move(chunk.bytes)});
+  } else {
+    section->rawSize = chunk.rawSize;
+    section->compressed = std::move(chunk.bytes);
+  }
+  chunk.bytes.clear();
+}
+
+bool RegionFile::hasPendingWrites() const {
+  std::shared_lock<std::shared_mutex> lock{mutex};
+  return !pending.empty();
+}
+
+size_t RegionFile::fileSize() const {
+  std::shared_lock<std::shared_mutex> lock{mutex};
+  return mappedSize;
+}
+
+void RegionFile::flush() {
+  std::unique_lock<std::shared_mutex> lock{mutex};
+  if (pending.empty()) {
+    return;
+  }
+
+  std::vector<uint8_t> file(HEADER_SIZE, 0);
+  std::memcpy(file.data(), MAGIC, sizeof(MAGIC));
+  store32(file.data() + 4, VERSION);
+  store32(file.data() + 8, LAYOUT);
+  for (int column = 0; column < COLUMNS; column++) {
+    auto staged = pending.find(column);
+    std::vector<Section> sections = staged != pending.end() ? std::move(staged->second) : mappedColumn(column);
+    if (sections.empty()) {
+      continue;
+    }
+    size_t offset = file.size();
+    file.resize(offset + 4 + sections.size() * SECTION_ENTRY_SIZE);
+    store32(file.data() + offset, static_cast<uint32_t>(sections.size()));
+    for (size_t s = 0; s < sections.size(); s++) {
+      uint8_t* sectionEntry = file.data() + offset + 4 + s * SECTION_ENTRY_SIZE;
+      store32(sectionEntry, static_cast<uint32_t>(sections[s].y));
+      store32(sectionEntry + 4, sections[s].rawSize);
+      store32(sectionEntry + 8, static_cast<uint32_t>(sections[s].compressed.size()));
+    }
+    for (const Section& section : sections) {
+      file.insert(file.end(), section.compressed.begin(), section.compressed.end());
+    }
+    store32(file.data() + 16 + column * 8, static_cast<uint32_t>(offset));
+    store32(file.data() + 16 + column * 8 + 4, static_cast<uint32_t>(file.size() - offset));
+  }
+  pending.clear();
+
+  std::filesystem::path target{path};
+  if (target.has_parent_path()) {
+    std::filesystem::create_directories(target.parent_path());
+  }
+  std::string written = path + ".tmp";
+  {
+    std::ofstream out{written, std::ios::binary | std::ios::trunc};
+    out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+    if (!out) {
+      panic("failed to write region " + written);
+    }
+  }
+  // the old mapping has to go before the file under it is replaced on Windows
+  unmap();
+  std::error_code error;
+  std::filesystem::rename(written, target, error);
+  if (error) {
+    panic("failed to replace region " + path + ": " + error.message());
+  }
+  map();
+}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "defines.hpp"
+#include "voxel_palette.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+namespace zx {
+
+// The chunks of a 32 by 32 group of chunk columns in one file, every chunk a serialized
+// PalettedVoxels compressed in the LZ4 block format. A header holds the offset and size of each
+// column, a column starts with the height, raw size and compressed size of every chunk in it
+// followed by the compressed chunks:
+//
+//   "ZXRG" | version | voxel layout | unused | 1024 x (offset, size) | columns...
+//   column: count | count x (y, raw size, compressed size) | compressed chunks...
+//
+// The file is memory mapped and reading a chunk inflates it straight out of the mapping. Writes
+// are staged per column and flush writes a new file next to the old one and swaps it in, so a
+// crash while saving leaves the previous save intact. All values are little-endian.
+//
+// Any thread may read chunks, also while another stages or flushes. Compressing takes no lock,
+// so World compresses on its workers and only stages on the thread that owns the chunks.
+class RegionFile {
+ public:
+  // chunk columns per side
+  static constexpr int REGION_SIZE = 32;
+  static constexpr int COLUMNS = REGION_SIZE * REGION_SIZE;
+
+  // maps path if it exists, a missing or unreadable file reads as an empty region
+  explicit RegionFile(const std::string& path);
+  ~RegionFile();
+
+  RegionFile(const RegionFile &) = delete;
+  RegionFile &operator=(const RegionFile &) = delete;
+
+  // the region holding the column of chunkPos, in regions along x and z
+  static glm::ivec2 regionOf(const glm::ivec3& chunkPos);
+
+  // a chunk serialized and compressed, ready to be staged
+  struct CompressedChunk {
+    uint32_t rawSize = 0;
+    std::vector<uint8_t> bytes;
+  };
+  // serializes through voxelScratch().entries, out keeps its capacity
+  static void compress(const PalettedVoxels& voxels, CompressedChunk& out);
+
+  // false, leaving voxels as they were, when the region does not hold chunkPos
+  bool readChunk(const glm::ivec3& chunkPos, PalettedVoxels& voxels) const;
+  // compressed right away, on disk after the next flush
+  void writeChunk(const glm::ivec3& chunkPos, const PalettedVoxels& voxels);
+  // stages a chunk compress made, taking its bytes over
+  void writeCompressed(const glm::ivec3& chunkPos, CompressedChunk& chunk);
+  bool hasPendingWrites() const;
+  // rewrites the file with the staged chunks and maps the new one
+  void flush();
+
+  const std::string& filePath() const { return path; }
+  // bytes of the mapped file, 0 for an empty region
+  size_t fileSize() const;
+
+ private:
+  struct Section {
+    int32_t y;
+    uint32_t rawSize;
+    std::vector<uint8_t> compressed;
+  };
+
+  static int columnIndex(const glm::ivec3& chunkPos);
+  // the sections the mapped file holds for a column, empty when it holds none
+  std::vector<Section> mappedColumn(int column) const;
+  void map();
+  void unmap();
+
+  std::string path;
+  // shared by readers, held alone while staging, flushing and mapping
+  mutable std::shared_mutex mutex;
+  const uint8_t* mapped = nullptr;
+  size_t mappedSize = 0;
+  // whole columns, old sections included, replaced by the next flush
+  std::map<int, std::vector<Section>> pending;
+};
+}
@@ -0,0 +1,233 @@
+#include "simplex_noise.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ZX_SIMPLEX_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace zx {
+namespace {
+
+// One lane type per instruction set, all with the same few operations the kernel is written in.
+// step(edge, x) is glm's, 0 where x < edge and 1 elsewhere.
+#if defined(__AVX2__)
+struct Lanes {
+  static constexpr int WIDTH = 8;
+  static constexpr const char* PATH = "avx2";
+  __m256 v;
+
+  Lanes(__m256 v) : v{v} {}
+  Lanes(float f) : v{_mm256_set1_ps(f)} {}
+  static Lanes load(const float* p) { return _mm256_loadu_ps(p); }
+  void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+  friend Lanes operator+(Lanes a, Lanes b) { return _mm256_add_ps(a.v, b.v); }
+  friend Lanes operator-(Lanes a, Lanes b) { return _mm256_sub_ps(a.v, b.v); }
+  friend Lanes operator*(Lanes a, Lanes b) { return _mm256_mul_ps(a.v, b.v); }
+  friend Lanes floor(Lanes a) { return _mm256_floor_ps(a.v); }
+  friend Lanes min(Lanes a, Lanes b) { return _mm256_min_ps(a.v, b.v); }
+  friend Lanes max(Lanes a, Lanes b) { return _mm256_max_ps(a.v, b.v); }
+  friend Lanes abs(Lanes a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v); }
+  friend Lanes step(Lanes edge, Lanes x) {
+    return _mm256_and_ps(_mm256_cmp_ps(x.v, edge.v, _CMP_NLT_UQ), _mm256_set1_ps(1.f));
+  }
+};
+#elif defined(__SSE4_1__) || defined(ZX_SIMPLEX_SSE2)
+struct Lanes {
+  static constexpr int WIDTH = 4;
+#if defined(__SSE4_1__)
+  static constexpr const char* PATH = "sse4.1";
+#else
+  static constexpr const char* PATH = "sse2";
+#endif
+  __m128 v;
+
+  Lanes(__m128 v) : v{v} {}
+  Lanes(float f) : v{_mm_set1_ps(f)} {}
+  static Lanes load(const float* p) { return _mm_loadu_ps(p); }
+  void store(float* p) const { _mm_storeu_ps(p, v); }
+
+  friend Lanes operator+(Lanes a, Lanes b) { return _mm_add_ps(a.v, b.v); }
+  friend Lanes operator-(Lanes a, Lanes b) { return _mm_sub_ps(a.v, b.v); }
+  friend Lanes operator*(Lanes a, Lanes b) { return _mm_mul_ps(a.v, b.v); }
+  friend Lanes floor(Lanes a) {
+#if defined(__SSE4_1__)
+    return _mm_floor_ps(a.v);
+#else
+    // truncate and step down where that rounded up, floats from 2^23 on are whole already
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    __m128 floored = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a.v), _mm_set1_ps(1.f)));
+    __m128 whole = _mm_cmpge_ps(abs(a).v, _mm_set1_ps(8388608.f));
+    return _mm_or_ps(_mm_and_ps(whole, a.v), _mm_andnot_ps(whole, floored));
+#endif
+  }
+  friend Lanes min(Lanes a, Lanes b) { return _mm_min_ps(a.v, b.v); }
+  friend Lanes max(Lanes a, Lanes b) { return _mm_max_ps(a.v, b.v); }
+  friend Lanes abs(Lanes a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+  friend Lanes step(Lanes edge, Lanes x) { return _mm_and_ps(_mm_cmpnlt_ps(x.v, edge.v), _mm_set1_ps(1.f)); }
+};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+struct Lanes {
+  static constexpr int WIDTH = 4;
+  static constexpr const char* PATH = "neon";
+  float32x4_t v;
+
+  Lanes(float32x4_t v) : v{v} {}
+  Lanes(float f) : v{vdupq_n_f32(f)} {}
+  static Lanes load(const float* p) { return vld1q_f32(p); }
+  void store(float* p) const { vst1q_f32(p, v); }
+
+  friend Lanes operator+(Lanes a, Lanes b) { return vaddq_f32(a.v, b.v); }
+  friend Lanes operator-(Lanes a, Lanes b) { return vsubq_f32(a.v, b.v); }
+  friend Lanes operator*(Lanes a, Lanes b) { return vmulq_f32(a.v, b.v); }
+  friend Lanes floor(Lanes a) { return vrndmq_f32(a.v); }
+  friend Lanes min(Lanes a, Lanes b) { return vminq_f32(a.v, b.v); }
+  friend Lanes max(Lanes a, Lanes b) { return vmaxq_f32(a.v, b.v); }
+  friend Lanes abs(Lanes a) { return vabsq_f32(a.v); }
+  friend Lanes step(Lanes edge, Lanes x) {
+    uint32x4_t below = vcltq_f32(x.v, edge.v);
+    return vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(vdupq_n_f32(1.f)), below));
+  }
+};
+#else
+struct Lanes {
+  static constexpr int WIDTH = 1;
+  static constexpr const char* PATH = "scalar";
+  float v;
+
+  Lanes(float f) : v{f} {}
+  static Lanes load(const float* p) { return *p; }
+  void store(float* p) const { *p = v; }
+
+  friend Lanes operator+(Lanes a, Lanes b) { return a.v + b.v; }
+  friend Lanes operator-(Lanes a, Lanes b) { return a.v - b.v; }
+  friend Lanes operator*(Lanes a, Lanes b) { return a.v * b.v; }
+  friend Lanes floor(Lanes a) { return std::floor(a.v); }
+  friend Lanes min(Lanes a, Lanes b) { return std::min(a.v, b.v); }
+  friend Lanes max(Lanes a, Lanes b) { return std::max(a.v, b.v); }
+  friend Lanes abs(Lanes a) { return std::fabs(a.v); }
+  friend Lanes step(Lanes edge, Lanes x) { return x.v < edge.v ? 0.f : 1.f; }
+};
+#endif
+
+Lanes mod289(Lanes x) {
+  return x - floor(x * (1.f / 289.f)) * 289.f;
+}
+
+Lanes permute(Lanes x) {
+  return mod289((x * 34.f + 1.f) * x);
+}
+
+// The four corners of the simplex around a point, their gradient and their share of the noise.
+// Written out per component from glm::simplex(vec3) in gtc/noise.inl, in the same order of
+// operations, so each lane rounds exactly like the vector code there does.
+struct Corner {
+  Lanes x, y, z;
+};
+
+// glm sums a vec3 dot product left to right, a vec4 one in pairs
+Lanes dot(const Corner& a, const Corner& b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+Lanes simplex(Lanes vx, Lanes vy, Lanes vz) {
+  const float Cx = 1.f / 6.f;
+  const float Cy = 1.f / 3.f;
+
+  // first corner
+  Lanes skew = vx * Cy + vy * Cy + vz * Cy;
+  Lanes ix = floor(vx + skew);
+  Lanes iy = floor(vy + skew);
+  Lanes iz = floor(vz + skew);
+  Lanes unskew = ix * Cx + iy * Cx + iz * Cx;
+  Corner x0{vx - ix + unskew, vy - iy + unskew, vz - iz + unskew};
+
+  // other corners
+  Lanes gx = step(x0.y, x0.x);
+  Lanes gy = step(x0.z, x0.y);
+  Lanes gz = step(x0.x, x0.z);
+  Lanes lx = Lanes{1.f} - gx;
+  Lanes ly = Lanes{1.f} - gy;
+  Lanes lz = Lanes{1.f} - gz;
+  Corner i1{min(gx, lz), min(gy, lx), min(gz, ly)};
+  Corner i2{max(gx, lz), max(gy, lx), max(gz, ly)};
+  Corner x1{x0.x - i1.x + Cx, x0.y - i1.y + Cx, x0.z - i1.z + Cx};
+  Corner x2{x0.x - i2.x + Cy, x0.y - i2.y + Cy, x0.z - i2.z + Cy};
+  Corner x3{x0.x - 0.5f, x0.y - 0.5f, x0.z - 0.5f};
+
+  // permutations
+  ix = mod289(ix);
+  iy = mod289(iy);
+  iz = mod289(iz);
+  Lanes p[4] = {
+      permute(permute(permute(iz + 0.f) + iy + 0.f) + ix + 0.f),
+      permute(permute(permute(iz + i1.z) + iy + i1.y) + ix + i1.x),
+      permute(permute(permute(iz + i2.z) + iy + i2.y) + ix + i2.x),
+      permute(permute(permute(iz + 1.f) + iy + 1.f) + ix + 1.f),
+  };
+
+  // gradients, 7 by 7 points over a square mapped onto an octahedron
+  const float n_ = 0.142857142857f;
+  const float nsx = n_ * 2.f - 0.f;
+  const float nsy = n_ * 0.5f - 1.f;
+  const float nsz = n_ * 1.f - 0.f;
+  Corner gradients[4] = {x0, x0, x0, x0};
+  for (int c = 0; c < 4; c++) {
+    Lanes j = p[c] - floor(p[c] * nsz * nsz) * 49.f;
+    Lanes x_ = floor(j * nsz);
+    Lanes y_ = floor(j - x_ * 7.f);
+    Lanes x = x_ * nsx + nsy;
+    Lanes y = y_ * nsx + nsy;
+    Lanes h = Lanes{1.f} - abs(x) - abs(y);
+    Lanes sh = Lanes{0.f} - step(h, 0.f);
+    Corner gradient{x + (floor(x) * 2.f + 1.f) * sh, y + (floor(y) * 2.f + 1.f) * sh, h};
+    Lanes norm = Lanes{1.79284291400159f} - dot(gradient, gradient) * 0.85373472095314f;
+    gradients[c] = Corner{gradient.x * norm, gradient.y * norm, gradient.z * norm};
+  }
+
+  // mix the final noise value
+  Lanes m0 = max(Lanes{0.6f} - dot(x0, x0), 0.f);
+  Lanes m1 = max(Lanes{0.6f} - dot(x1, x1), 0.f);
+  Lanes m2 = max(Lanes{0.6f} - dot(x2, x2), 0.f);
+  Lanes m3 = max(Lanes{0.6f} - dot(x3, x3), 0.f);
+  m0 = m0 * m0;
+  m1 = m1 * m1;
+  m2 = m2 * m2;
+  m3 = m3 * m3;
+  Lanes mixed = (m0 * m0 * dot(gradients[0], x0) + m1 * m1 * dot(gradients[1], x1)) +
+                (m2 * m2 * dot(gradients[2], x2) + m3 * m3 * dot(gradients[3], x3));
+  return mixed * 42.f;
+}
+
+}
+
+const int SIMPLEX_LANES = Lanes::WIDTH;
+const char* const SIMPLEX_PATH = Lanes::PATH;
+
+void simplexBatch(const float* x, const float* y, float z, float* out, size_t count) {
+  size_t i = 0;
+  for (; i + Lanes::WIDTH <= count; i += Lanes::WIDTH) {
+    simplex(Lanes::load(x + i), Lanes::load(y + i), z).store(out + i);
+  }
+  if (i == count) {
+    return;
+  }
+  // the tail padded out to a full set of lanes
+  float tailX[Lanes::WIDTH] = {};
+  float tailY[Lanes::WIDTH] = {};
+  float tailOut[Lanes::WIDTH];
+  std::copy(x + i, x + count, tailX);
+  std::copy(y + i, y + count, tailY);
+  simplex(Lanes::load(tailX), Lanes::load(tailY), z).store(tailOut);
+  std::copy(tailOut, tailOut + (count - i), out + i);
+}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+namespace zx {
+
+// glm::simplex(vec3) for many points at once. The points lie in the plane at height z, which is
+// how terrain samples it with the seed as z. The code follows glm's step for step in whatever
+// SIMD instructions the build targets, SIMPLEX_LANES points per instruction:
+//
+//   AVX2 (ZENIX_AVX2)   8 lanes
+//   SSE2 / SSE4.1       4 lanes, x86-64 always has SSE2
+//   NEON (AArch64)      4 lanes
+//   anything else       1 lane, the plain scalar code
+//
+// Every path rounds exactly like glm::simplex as long as neither side fuses multiplies and adds,
+// which is why CMake builds this and ZenixNoiseBench with -ffp-contract=off. With FMAs the
+// floors near cell borders amplify the rounding to about 1e-3 at coordinates in the thousands, so
+// SIMPLEX_TOLERANCE only covers builds that keep them apart. ZenixNoiseBench checks it and
+// measures the speedup.
+constexpr float SIMPLEX_TOLERANCE = 1e-5f;
+
+extern const int SIMPLEX_LANES;
+// "avx2", "sse4.1", "sse2", "neon" or "scalar"
+extern const char* const SIMPLEX_PATH;
+
+// out[i] = glm::simplex(vec3{x[i], y[i], z}), in and out may not overlap
+void simplexBatch(const float* x, const float* y, float z, float* out, size_t count);
+}
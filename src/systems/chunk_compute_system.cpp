@@ -0,0 +1,237 @@
+#include "chunk_compute_system.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace zx {
+
+namespace {
+// chunks per submission, the descriptor pool is sized for this many sets
+constexpr uint32_t MAX_BATCH = 64;
+// matches local_size in voxel_mesh.comp
+constexpr uint32_t GROUP_SIZE = 4;
+constexpr int PADDED_SIZE = CHUNK_SIZE + 2;
+constexpr uint32_t PADDED_VOLUME = PADDED_SIZE * PADDED_SIZE * PADDED_SIZE;
+// enough for most terrain chunks, the rest overflow once and are dispatched again
+constexpr uint32_t INITIAL_FACE_CAPACITY = 6 * CHUNK_AREA;
+
+static_assert(CHUNK_SIZE % GROUP_SIZE == 0, "chunks must split into whole workgroups");
+
+struct MeshPushConstantData {
+  uint32_t faceCapacity;
+};
+}
+
+ChunkComputeSystem::ChunkComputeSystem(ZxDevice &device) : zxDevice{device} {
+  createDescriptors();
+  createPipelineLayout();
+  createPipeline();
+}
+
+ChunkComputeSystem::~ChunkComputeSystem() {
+  vkDestroyPipelineLayout(zxDevice.device(), pipelineLayout, nullptr);
+}
+
+void ChunkComputeSystem::createDescriptors() {
+  meshSetLayout = ZxDescriptorSetLayout::Builder(zxDevice)
+                      .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                      .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                      .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                      .build();
+  meshPool = ZxDescriptorPool::Builder(zxDevice)
+                 .setMaxSets(MAX_BATCH)
+                 .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_BATCH * 3)
+                 .build();
+}
+
+void ChunkComputeSystem::createPipelineLayout() {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(MeshPushConstantData);
+
+  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{meshSetLayout->getDescriptorSetLayout()};
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+  pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  if (vkCreatePipelineLayout(zxDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
+      VK_SUCCESS) {
+    panic("Failed to create pipeline layout!");
+  }
+}
+
+void ChunkComputeSystem::createPipeline() {
+  assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
+
+  zxPipeline = std::make_unique<ZxComputePipeline>(
+      zxDevice,
+      "shaders/voxel_mesh.comp.spv",
+      pipelineLayout);
+}
+
+void ChunkComputeSystem::meshChunks(
+    const std::vector<Chunk *> &chunks, const std::vector<ChunkNeighbours> &neighbours) {
+  assert(chunks.size() == neighbours.size() && "Every chunk needs its neighbours");
+
+  // The dispatch rewrites face and draw command buffers in place and reads the face counts
+  // back, so unlike the CPU meshed uploads it waits for the queue, pending uploads included.
+  zxDevice.submitUploads();
+  vkQueueWaitIdle(zxDevice.graphicsQueue());
+
+  for (Chunk *chunk : chunks) {
+    if (!chunk->faceBuffer) {
+      chunk->createFaceBuffers(INITIAL_FACE_CAPACITY);
+    }
+  }
+
+  std::vector<size_t> pending(chunks.size());
+  for (size_t i = 0; i < pending.size(); i++) {
+    pending[i] = i;
+  }
+  // the second round only holds chunks that overflowed, with buffers grown to fit
+  while (!pending.empty()) {
+    std::vector<size_t> overflowed;
+    for (size_t first = 0; first < pending.size(); first += MAX_BATCH) {
+      size_t last = std::min(pending.size(), first + MAX_BATCH);
+      std::vector<size_t> batch{pending.begin() + first, pending.begin() + last};
+      std::vector<size_t> batchOverflowed = dispatch(chunks, neighbours, batch);
+      overflowed.insert(overflowed.end(), batchOverflowed.begin(), batchOverflowed.end());
+    }
+    pending = overflowed;
+  }
+}
+
+std::vector<size_t> ChunkComputeSystem::dispatch(
+    const std::vector<Chunk *> &chunks,
+    const std::vector<ChunkNeighbours> &neighbours,
+    const std::vector<size_t> &batch) {
+  // the voxels of the whole batch, each chunk padded with the border voxels of its neighbours
+  uint32_t paddedWords = PADDED_VOLUME / 4 + 1;
+  ZxBuffer voxelBuffer{
+      zxDevice,
+      sizeof(uint32_t) * paddedWords,
+      static_cast<uint32_t>(batch.size()),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      zxDevice.properties.limits.minStorageBufferOffsetAlignment,
+  };
+  voxelBuffer.map();
+
+  std::vector<uint8_t> padded(paddedWords * sizeof(uint32_t));
+  for (size_t b = 0; b < batch.size(); b++) {
+    Chunk &chunk = *chunks[batch[b]];
+    const ChunkNeighbours &chunkNeighbours = neighbours[batch[b]];
+    // edges and corners are never looked at, they stay air
+    std::fill(padded.begin(), padded.end(), 0);
+    for (int z = -1; z <= CHUNK_SIZE; z++) {
+      for (int y = -1; y <= CHUNK_SIZE; y++) {
+        for (int x = -1; x <= CHUNK_SIZE; x++) {
+          int outside = (x < 0 || x >= CHUNK_SIZE) + (y < 0 || y >= CHUNK_SIZE) + (z < 0 || z >= CHUNK_SIZE);
+          if (outside > 1) {
+            continue;
+          }
+          int index = (x + 1) + (y + 1) * PADDED_SIZE + (z + 1) * PADDED_SIZE * PADDED_SIZE;
+          padded[index] = static_cast<uint8_t>(chunk.getVoxel(x, y, z, chunkNeighbours));
+        }
+      }
+    }
+    voxelBuffer.writeToIndex(padded.data(), static_cast<int>(b));
+
+    if (!chunk.drawCommandBuffer) {
+      chunk.drawCommandBuffer = std::make_unique<ZxBuffer>(
+          zxDevice,
+          sizeof(Chunk::DrawCommand),
+          1,
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+      chunk.drawCommandBuffer->map();
+    }
+    Chunk::DrawCommand command{};
+    command.draw.instanceCount = 1;
+    chunk.drawCommandBuffer->writeToBuffer(&command);
+  }
+
+  VkCommandBuffer commandBuffer = zxDevice.beginSingleTimeCommands();
+  zxPipeline->bind(commandBuffer);
+
+  std::vector<VkDescriptorSet> descriptorSets(batch.size());
+  for (size_t b = 0; b < batch.size(); b++) {
+    Chunk &chunk = *chunks[batch[b]];
+    auto voxelInfo = voxelBuffer.descriptorInfoForIndex(static_cast<int>(b));
+    auto faceInfo = chunk.faceBuffer->descriptorInfo();
+    auto commandInfo = chunk.drawCommandBuffer->descriptorInfo();
+    if (!ZxDescriptorWriter(*meshSetLayout, *meshPool)
+             .writeBuffer(0, &voxelInfo)
+             .writeBuffer(1, &faceInfo)
+             .writeBuffer(2, &commandInfo)
+             .build(descriptorSets[b])) {
+      panic("Failed to allocate chunk mesh descriptor set!");
+    }
+
+    vkCmdBindDescriptorSets(
+        commandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        pipelineLayout,
+        0,
+        1,
+        &descriptorSets[b],
+        0,
+        nullptr);
+
+    MeshPushConstantData push{chunk.faceCapacity};
+    vkCmdPushConstants(
+        commandBuffer,
+        pipelineLayout,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        0,
+        sizeof(MeshPushConstantData),
+        &push);
+    vkCmdDispatch(
+        commandBuffer, CHUNK_SIZE / GROUP_SIZE, CHUNK_SIZE / GROUP_SIZE, CHUNK_SIZE / GROUP_SIZE);
+  }
+
+  // the faces are read by the vertex shader, the command by the indirect draw and the host
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+          VK_PIPELINE_STAGE_HOST_BIT,
+      0,
+      1,
+      &barrier,
+      0,
+      nullptr,
+      0,
+      nullptr);
+
+  zxDevice.endSingleTimeCommands(commandBuffer);
+  meshPool->resetPool();
+
+  std::vector<size_t> overflowed;
+  for (size_t index : batch) {
+    Chunk &chunk = *chunks[index];
+    Chunk::DrawCommand command;
+    std::memcpy(&command, chunk.drawCommandBuffer->getMappedMemory(), sizeof(command));
+
+    chunk.gpuMeshed = true;
+    chunk.faceCount = command.faceCount;
+    chunk.indexCount = command.draw.indexCount;
+    chunk.faceBufferChanged = true;
+    if (command.faceCount > chunk.faceCapacity) {
+      chunk.createFaceBuffers(command.faceCount + command.faceCount / 4);
+      overflowed.push_back(index);
+    }
+  }
+  return overflowed;
+}
+}
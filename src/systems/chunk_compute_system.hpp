@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../chunk.hpp"
+#include "../defines.hpp"
+#include "../zx_buffer.hpp"
+#include "../zx_descriptors.hpp"
+#include "../zx_device.hpp"
+#include "../zx_pipeline.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace zx {
+// Meshes chunks on the GPU with voxel_mesh.comp. The voxels of a batch are uploaded once,
+// the shader culls the faces and appends them straight to each chunk's face buffer and
+// indirect draw command, so no face goes through the CPU.
+class ChunkComputeSystem {
+ public:
+  ChunkComputeSystem(ZxDevice &device);
+  ~ChunkComputeSystem();
+
+  ChunkComputeSystem(const ChunkComputeSystem &) = delete;
+  ChunkComputeSystem &operator=(const ChunkComputeSystem &) = delete;
+
+  // neighbours[i] belongs to chunks[i], waits for the queue to go idle first since the buffers
+  // are rewritten in place
+  void meshChunks(const std::vector<Chunk *> &chunks, const std::vector<ChunkNeighbours> &neighbours);
+
+ private:
+  void createDescriptors();
+  void createPipelineLayout();
+  void createPipeline();
+  // one submission for up to MAX_BATCH chunks, returns the ones whose face buffer overflowed
+  std::vector<size_t> dispatch(
+      const std::vector<Chunk *> &chunks,
+      const std::vector<ChunkNeighbours> &neighbours,
+      const std::vector<size_t> &batch);
+
+  ZxDevice &zxDevice;
+
+  std::unique_ptr<ZxComputePipeline> zxPipeline;
+  VkPipelineLayout pipelineLayout;
+
+  std::unique_ptr<ZxDescriptorSetLayout> meshSetLayout;
+  std::unique_ptr<ZxDescriptorPool> meshPool;
+};
+}
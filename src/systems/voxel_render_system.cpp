@@ -7,6 +7,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <stdexcept>
@@ -14,6 +15,29 @@
 
 namespace zx {
 
+// One face descriptor set per chunk that ever had faces, plus the few replaced sets waiting for
+// the frames in flight. Pools of this many are added as the chunk objects grow in number, so any
+// view distance fits.
+constexpr uint32_t FACE_SETS_PER_POOL = 1024;
+
+namespace {
+// Faces of a direction can only be seen from in front of at least one of their planes. For a
+// chunk at chunkMin the +x faces lie on planes chunkMin.x + 1 .. chunkMin.x + CHUNK_SIZE and
+// the -x faces on chunkMin.x .. chunkMin.x + CHUNK_SIZE - 1, likewise for y and z.
+uint32_t visibleDirections(const glm::vec3& chunkMin, const glm::vec3& cameraPosition) {
+  uint32_t directions = 0;
+  for (int face = 0; face < 6; face++) {
+    glm::ivec3 n = voxel_normals[face];
+    int d = n.x != 0 ? 0 : n.y != 0 ? 1 : 2;
+    bool visible = n[d] > 0 ? cameraPosition[d] > chunkMin[d] : cameraPosition[d] < chunkMin[d] + CHUNK_SIZE;
+    if (visible) {
+      directions |= 1u << face;
+    }
+  }
+  return directions;
+}
+}
+
 struct VoxelPushConstantData {
   glm::mat4 modelMatrix{1.f};
   glm::mat4 normalMatrix{1.f};
@@ -22,21 +46,39 @@ struct VoxelPushConstantData {
 VoxelRenderSystem::VoxelRenderSystem(
     ZxDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
     : zxDevice{device} {
+  createFaceDescriptors();
   createPipelineLayout(globalSetLayout);
   createPipeline(renderPass);
+  createQuadIndexBuffer();
 }
 
 VoxelRenderSystem::~VoxelRenderSystem() {
   vkDestroyPipelineLayout(zxDevice.device(), pipelineLayout, nullptr);
 }
 
+void VoxelRenderSystem::createFaceDescriptors() {
+  faceSetLayout = ZxDescriptorSetLayout::Builder(zxDevice)
+                      .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+                      .build();
+  addFacePool();
+}
+
+void VoxelRenderSystem::addFacePool() {
+  facePools.push_back(ZxDescriptorPool::Builder(zxDevice)
+                          .setMaxSets(FACE_SETS_PER_POOL)
+                          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, FACE_SETS_PER_POOL)
+                          .build());
+  faceSetsLeft = FACE_SETS_PER_POOL;
+}
+
 void VoxelRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
   VkPushConstantRange pushConstantRange{};
   pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
   pushConstantRange.offset = 0;
   pushConstantRange.size = sizeof(VoxelPushConstantData);
 
-  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
+  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+      globalSetLayout, faceSetLayout->getDescriptorSetLayout()};
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -54,7 +96,8 @@ void VoxelRenderSystem::createPipeline(VkRenderPass renderPass) {
   assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
 
   PipelineConfigInfo pipelineConfig{};
-  ZxPipeline::defaultPipelineConfigInfo(pipelineConfig, Chunk::Vertex::getBindingDescriptions(), Chunk::Vertex::getAttributeDescriptions());
+  // vertices are pulled from the chunk face buffers, so there is no vertex input
+  ZxPipeline::defaultPipelineConfigInfo(pipelineConfig, {}, {});
   pipelineConfig.renderPass = renderPass;
   pipelineConfig.pipelineLayout = pipelineLayout;
   zxPipeline = std::make_unique<ZxPipeline>(
@@ -62,10 +105,99 @@ void VoxelRenderSystem::createPipeline(VkRenderPass renderPass) {
       "shaders/voxel_shader.vert.spv",
       "shaders/voxel_shader.frag.spv",
       pipelineConfig);
+
+  // translucent faces blend over what is behind them and must not hide each other
+  PipelineConfigInfo translucentConfig{};
+  ZxPipeline::defaultPipelineConfigInfo(translucentConfig, {}, {});
+  ZxPipeline::enableAlphaBlending(translucentConfig);
+  translucentConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+  translucentConfig.renderPass = renderPass;
+  translucentConfig.pipelineLayout = pipelineLayout;
+  translucentPipeline = std::make_unique<ZxPipeline>(
+      zxDevice,
+      "shaders/voxel_shader.vert.spv",
+      "shaders/voxel_shader.frag.spv",
+      translucentConfig);
 }
 
-void VoxelRenderSystem::renderChunks(FrameInfo& frameInfo, std::vector<std::unique_ptr<World>> worlds) {
+void VoxelRenderSystem::createQuadIndexBuffer() {
+  std::vector<uint32_t> indices = ChunkMesher::quadIndices(ChunkMesher::MAX_QUADS);
+  uint32_t indexSize = sizeof(indices[0]);
+  uint32_t indexCount = static_cast<uint32_t>(indices.size());
+
+  ZxBuffer stagingBuffer{
+      zxDevice,
+      indexSize,
+      indexCount,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+  };
+
+  stagingBuffer.map();
+  stagingBuffer.writeToBuffer((void *)indices.data());
+
+  quadIndexBuffer = std::make_unique<ZxBuffer>(
+      zxDevice,
+      indexSize,
+      indexCount,
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  zxDevice.copyBuffer(stagingBuffer.getBuffer(), quadIndexBuffer->getBuffer(), indexSize * indexCount);
+}
+
+void VoxelRenderSystem::writeFaceDescriptor(Chunk& chunk, int frameIndex) {
+  // the frames in flight may still bind the old set, so it is replaced rather than rewritten
+  if (chunk.faceDescriptorSet != VK_NULL_HANDLE) {
+    retiredFaceSets[frameIndex].push_back(chunk.faceDescriptorSet);
+  }
+  auto faceInfo = chunk.faceBuffer->descriptorInfo();
+  // sets are never freed, so only the newest pool has room
+  if (freeFaceSets.empty() && faceSetsLeft == 0) {
+    addFacePool();
+  }
+  ZxDescriptorWriter writer{*faceSetLayout, *facePools.back()};
+  writer.writeBuffer(0, &faceInfo);
+  if (freeFaceSets.empty()) {
+    faceSetsLeft--;
+    if (!writer.build(chunk.faceDescriptorSet)) {
+      panic("Failed to allocate chunk face descriptor set!");
+    }
+  } else {
+    chunk.faceDescriptorSet = freeFaceSets.back();
+    freeFaceSets.pop_back();
+    writer.overwrite(chunk.faceDescriptorSet);
+  }
+  chunk.faceBufferChanged = false;
+}
+
+void VoxelRenderSystem::renderChunks(FrameInfo& frameInfo, const std::vector<std::unique_ptr<World>>& worlds) {
+  glm::vec3 cameraPosition = frameInfo.camera.getPosition();
+
+  // the frame that last recorded with this index has finished, so have the ones before it
+  std::vector<VkDescriptorSet>& retired = retiredFaceSets[frameInfo.frameIndex];
+  freeFaceSets.insert(freeFaceSets.end(), retired.begin(), retired.end());
+  retired.clear();
+
+  // nearest first, so opaque faces behind already drawn terrain fail the depth test early
+  std::vector<std::pair<float, ZxGameObject*>> sorted;
+  for (auto& world : worlds) {
+    for(auto& chunk_obj : world->chunks) {
+      Chunk& chunk = *chunk_obj->chunk;
+      if (chunk.faceCount == 0) {
+        continue;
+      }
+      if (chunk.faceBufferChanged) {
+        writeFaceDescriptor(chunk, frameInfo.frameIndex);
+      }
+      glm::vec3 offset = chunk_obj->transform.translation + glm::vec3(CHUNK_SIZE / 2.f) - cameraPosition;
+      sorted.emplace_back(glm::dot(offset, offset), chunk_obj.get());
+    }
+  }
+  std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
   zxPipeline->bind(frameInfo.commandBuffer);
+  vkCmdBindIndexBuffer(frameInfo.commandBuffer, quadIndexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
   vkCmdBindDescriptorSets(
       frameInfo.commandBuffer,
@@ -77,22 +209,34 @@ void VoxelRenderSystem::renderChunks(FrameInfo& frameInfo, std::vector<std::uniq
       0,
       nullptr);
 
-  for (auto& world : worlds) {
-    for(auto& chunk_obj : world->chunks) {
-      VoxelPushConstantData push{};
-      push.modelMatrix = chunk_obj->transform.mat4();
-      push.normalMatrix = chunk_obj->transform.normalMatrix();
-
-      vkCmdPushConstants(
-          frameInfo.commandBuffer,
-          pipelineLayout,
-          VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-          0,
-          sizeof(VoxelPushConstantData),
-          &push);
-      chunk_obj->chunk->bind(frameInfo.commandBuffer);
-      chunk_obj->chunk->draw(frameInfo.commandBuffer);
+  for (auto& entry : sorted) {
+    drawChunk(frameInfo, *entry.second, MeshStream::opaque, cameraPosition);
+  }
+
+  // farthest first, so nearer water blends over farther water
+  translucentPipeline->bind(frameInfo.commandBuffer);
+  for (auto it = sorted.rbegin(); it != sorted.rend(); ++it) {
+    if (it->second->chunk->hasTranslucentFaces()) {
+      drawChunk(frameInfo, *it->second, MeshStream::translucent, cameraPosition);
     }
   }
 }
-}
\ No newline at end of file
+
+void VoxelRenderSystem::drawChunk(
+    FrameInfo& frameInfo, ZxGameObject& chunk_obj, MeshStream stream, const glm::vec3& cameraPosition) {
+  VoxelPushConstantData push{};
+  push.modelMatrix = chunk_obj.transform.mat4();
+  push.normalMatrix = chunk_obj.transform.normalMatrix();
+
+  vkCmdPushConstants(
+      frameInfo.commandBuffer,
+      pipelineLayout,
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+      0,
+      sizeof(VoxelPushConstantData),
+      &push);
+  chunk_obj.chunk->bind(frameInfo.commandBuffer, pipelineLayout);
+  chunk_obj.chunk->draw(
+      frameInfo.commandBuffer, stream, visibleDirections(chunk_obj.transform.translation, cameraPosition));
+}
+}
@@ -1,16 +1,23 @@
 #pragma once
 
 #include "../defines.hpp"
+#include "../zx_buffer.hpp"
 #include "../zx_camera.hpp"
+#include "../zx_descriptors.hpp"
 #include "../zx_device.hpp"
 #include "../zx_frame_info.hpp"
 #include "../zx_game_object.hpp"
 #include "../zx_pipeline.hpp"
+#include "../zx_swap_chain.hpp"
 
+#include <array>
 #include <memory>
 #include <vector>
 
 namespace zx {
+class Chunk;
+class World;
+
 class VoxelRenderSystem {
  public:
   VoxelRenderSystem(
@@ -20,15 +27,36 @@ class VoxelRenderSystem {
   VoxelRenderSystem(const VoxelRenderSystem &) = delete;
   VoxelRenderSystem &operator=(const VoxelRenderSystem &) = delete;
 
-  void renderChunks(FrameInfo& frameInfo, std::vector<std::unique_ptr<World>> worlds);
+  void renderChunks(FrameInfo& frameInfo, const std::vector<std::unique_ptr<World>>& worlds);
 
  private:
+  void createFaceDescriptors();
+  void addFacePool();
   void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
   void createPipeline(VkRenderPass renderPass);
+  void createQuadIndexBuffer();
+  void writeFaceDescriptor(Chunk& chunk, int frameIndex);
+  void drawChunk(
+      FrameInfo& frameInfo, ZxGameObject& chunk_obj, MeshStream stream, const glm::vec3& cameraPosition);
 
   ZxDevice &zxDevice;
 
   std::unique_ptr<ZxPipeline> zxPipeline;
+  std::unique_ptr<ZxPipeline> translucentPipeline;
   VkPipelineLayout pipelineLayout;
+
+  // every chunk quad uses the same index pattern, so one buffer sized for the fullest
+  // possible chunk is bound once and shared by all chunk draws
+  std::unique_ptr<ZxBuffer> quadIndexBuffer;
+
+  // set 1, the storage buffer of packed faces each chunk pulls its vertices from
+  std::unique_ptr<ZxDescriptorSetLayout> faceSetLayout;
+  // filled one after the other, sets are allocated from the last one
+  std::vector<std::unique_ptr<ZxDescriptorPool>> facePools;
+  uint32_t faceSetsLeft = 0;
+  // A set replaced while recording frame index i may still be bound by the frames in flight,
+  // it is reused once frame index i comes around again and those have finished.
+  std::array<std::vector<VkDescriptorSet>, ZxSwapChain::MAX_FRAMES_IN_FLIGHT> retiredFaceSets;
+  std::vector<VkDescriptorSet> freeFaceSets;
 };
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "terrain_generator.hpp"
+
+#include "voxel_arena.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace zx {
+namespace {
+float rounded(const glm::vec2& coord){
+    auto bump = [](float t) { return glm::max(0.0f, 1.0f - std::pow(t, 6.0f)); };
+    float b = bump(coord.x) * bump(coord.y);
+    return b * ISLAND_SCALE;
+}
+
+// a height only truncates what the noise gives, so the noise bound holds for it as well
+static_assert(TERRAIN_MAX_HEIGHT + HEIGHT_DROP >= static_cast<int>(TerrainNoise::MAX * ISLAND_SCALE * ISLAND_BOOST),
+              "TERRAIN_MAX_HEIGHT is below the peak of an island");
+static_assert(TERRAIN_MAX_HEIGHT + HEIGHT_DROP >= static_cast<int>(TerrainNoise::MAX),
+              "TERRAIN_MAX_HEIGHT is below the peak of the endless terrain");
+}
+
+TerrainGenerator::TerrainGenerator(int seed, int islandSize) : seed{seed}, islandSize{islandSize} {}
+
+void TerrainGenerator::heightMap(const glm::ivec2& column, HeightMap& heights) const {
+    const float world_size = static_cast<float>(islandSize) * CHUNK_SIZE;
+
+    NoiseColumn noise;
+    if (tuning.empty()) {
+      TerrainNoise::sample(column, seed, noise);
+    } else {
+      tuning.sample(column, seed, noise);
+    }
+
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            float bx = static_cast<float>(x + column.x * CHUNK_SIZE);
+            float bz = static_cast<float>(z + column.y * CHUNK_SIZE);
+
+            float island = 1.0f;
+            if (islandSize > 0) {
+              glm::vec2 coord = (glm::vec2{bx, bz} - world_size / 2.0f) / world_size * 2.0f;
+              island = rounded(coord) * ISLAND_BOOST;
+            }
+            int height = static_cast<int>(noise[z * CHUNK_SIZE + x] * island) - HEIGHT_DROP;
+            heights[z * CHUNK_SIZE + x] = std::min(height, TERRAIN_MAX_HEIGHT);
+        }
+    }
+}
+
+void TerrainGenerator::fillChunk(const glm::ivec3& chunk_pos, const HeightMap& heights, PalettedVoxels& voxels) const {
+  // chunks above the highest column or below the lowest one are a single type, no voxel loop needed
+  int lowest = static_cast<int>(heights[0]);
+  int highest = lowest;
+  for (uint32_t height : heights) {
+    lowest = std::min(lowest, static_cast<int>(height));
+    highest = std::max(highest, static_cast<int>(height));
+  }
+  int bottom = chunk_pos.y * CHUNK_SIZE;
+  int top = bottom + CHUNK_SIZE - 1;
+  bool grass_layer = bottom <= WATER_LEVEL && WATER_LEVEL <= top;
+  if (bottom > highest || (top <= lowest && !grass_layer)) {
+    voxels.fill(bottom > highest ? air : stone);
+    return;
+  }
+
+  // generated as bytes and packed into the palette once
+  std::array<Voxel, CHUNK_VOLUME>& generated = voxelScratch().voxels;
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            int height = heights[z * CHUNK_SIZE + x];
+            int voxel_y = chunk_pos.y * CHUNK_SIZE + y;
+            Voxel voxel = air;
+
+            if(voxel_y <= height){
+              if(voxel_y > WATER_LEVEL){
+                voxel = stone;
+              }
+              else if(voxel_y == WATER_LEVEL){
+                voxel = grass;
+              }
+              else{
+                voxel = stone;
+              }
+            }
+            generated[voxelIndex(x, y, z)] = voxel;
+        }
+    }
+  }
+  voxels.encode(generated.data());
+}
+}
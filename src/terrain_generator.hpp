@@ -0,0 +1,55 @@
+#pragma once
+
+#include "defines.hpp"
+#include "noise_graph.hpp"
+#include "voxel.hpp"
+#include "voxel_palette.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace zx {
+
+// the broad shape of the terrain, scaled to heights, and the detail it is multiplied with
+inline constexpr NoiseSettings TERRAIN_SHAPE{6, 105.f, 205.f, 0.58f, 18.f};
+inline constexpr NoiseSettings TERRAIN_DETAIL{4, 20.f, 200.f, 0.45f, 0.f};
+using TerrainNoise = FixedNoiseGraph<TERRAIN_SHAPE, TERRAIN_DETAIL>;
+// The island falloff scales the noise by up to ISLAND_SCALE * ISLAND_BOOST at the island's
+// centre, more than the endless terrain gets. Every height is lowered by HEIGHT_DROP afterwards.
+inline constexpr float ISLAND_SCALE = 0.9f;
+inline constexpr float ISLAND_BOOST = 1.25f;
+inline constexpr int HEIGHT_DROP = 5;
+// The highest the terrain gets, where every layer is at its most in the middle of an island.
+// heightMap clamps to it, which only a tuning graph reaching higher than TerrainNoise runs into.
+inline constexpr int TERRAIN_MAX_HEIGHT =
+    static_cast<int>(TerrainNoise::MAX * std::max(1.0f, ISLAND_SCALE * ISLAND_BOOST)) - HEIGHT_DROP;
+
+// The terrain as a function of nothing but the chunk position, the seed and the island size.
+// It keeps no state between calls, so generation jobs run it on any thread and always get the
+// same voxels for the same chunk.
+class TerrainGenerator {
+ public:
+  // heights in voxels, stored unsigned but read as int since they may dip below zero
+  using HeightMap = std::array<uint32_t, CHUNK_AREA>;
+
+  // islandSize is the width of the island in chunks around the origin, 0 for endless terrain
+  TerrainGenerator(int seed, int islandSize);
+
+  // heights of the chunk column at column (x and z)
+  void heightMap(const glm::ivec2& column, HeightMap& heights) const;
+  // the voxels of chunk_pos from the height map of its column, generated through voxelScratch()
+  void fillChunk(const glm::ivec3& chunk_pos, const HeightMap& heights, PalettedVoxels& voxels) const;
+
+  int seed;
+  int islandSize;
+  // Replaces TerrainNoise while it has layers, for tuning the terrain without a rebuild. Set it
+  // before any chunk is generated, generation jobs read it from other threads. Heights above
+  // TERRAIN_MAX_HEIGHT are cut off, World only keeps the chunks up to it.
+  NoiseGraph tuning;
+};
+}
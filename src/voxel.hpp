@@ -0,0 +1,81 @@
+#pragma once
+
+#include "defines.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace zx {
+
+enum Voxel : uint8_t {
+  air,
+  stone,
+  grass,
+  sand,
+  water
+};
+constexpr int VOXEL_TYPES = water + 1;
+static_assert(sizeof(Voxel) == 1, "decoded chunks hold one byte per voxel");
+
+// Orders of the voxels in a chunk sized array. Linear keeps rows along x contiguous, Morton
+// interleaves the bits of x, y and z so voxels close along any axis are close in memory.
+struct LinearLayout {
+  static int index(int x, int y, int z) { return x + y * CHUNK_SIZE + z * CHUNK_SIZE * CHUNK_SIZE; }
+};
+
+struct MortonLayout {
+  static_assert((CHUNK_SIZE & (CHUNK_SIZE - 1)) == 0 && CHUNK_SIZE <= 1024,
+                "Morton order needs a power of two chunk size");
+
+  // the low ten bits of v, moved three bits apart
+  static uint32_t spread(uint32_t v) {
+    v = (v | v << 16) & 0x030000ff;
+    v = (v | v << 8) & 0x0300f00f;
+    v = (v | v << 4) & 0x030c30c3;
+    v = (v | v << 2) & 0x09249249;
+    return v;
+  }
+  static int index(int x, int y, int z) {
+    return static_cast<int>(spread(x) | spread(y) << 1 | spread(z) << 2);
+  }
+};
+
+// every chunk array goes through voxelIndex, building with ZX_MORTON_VOXELS switches them all
+#ifdef ZX_MORTON_VOXELS
+using VoxelLayout = MortonLayout;
+#else
+using VoxelLayout = LinearLayout;
+#endif
+
+inline int voxelIndex(int x, int y, int z) { return VoxelLayout::index(x, y, z); }
+
+// air and water let the faces behind them show through
+inline bool isOpaque(Voxel voxel) { return voxel != air && voxel != water; }
+
+// opaque faces are drawn first, front to back, translucent ones afterwards with blending
+enum class MeshStream {
+  opaque,
+  translucent
+};
+constexpr int MESH_STREAMS = 2;
+inline MeshStream meshStream(Voxel voxel) {
+  return isOpaque(voxel) ? MeshStream::opaque : MeshStream::translucent;
+}
+
+enum class MeshingStrategy {
+  culled, // one quad per visible voxel face
+  greedy, // coplanar faces of the same voxel merged into maximal rectangles
+  binary, // same merging as greedy, done on 64-bit column masks
+  gpu     // culled faces emitted by voxel_mesh.comp, see ChunkComputeSystem
+};
+const char* meshingStrategyName(MeshingStrategy strategy);
+
+// unit normal of each face: north (-z), south (+z), east (+x), west (-x), top (+y), bottom (-y)
+inline const glm::ivec3 voxel_normals[6] = { {0, 0, -1}, {0, 0, 1}, {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0} };
+// axis the face normal points along, 0 = x, 1 = y, 2 = z
+inline const int face_axis[6] = { 2, 2, 0, 0, 1, 1 };
+inline int oppositeFace(int face) { return face ^ 1; }
+}
@@ -0,0 +1,148 @@
+#include "voxel_arena.hpp"
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cstdlib>
+#endif
+
+namespace zx {
+namespace {
+// the largest huge page size mappings get rounded up to
+constexpr size_t HUGE_PAGE = 2 * 1024 * 1024;
+// room for the packed voxels of around sixteen thousand chunks, only touched pages are committed
+constexpr size_t GLOBAL_CAPACITY = 256 * 1024 * 1024;
+}
+
+VoxelArena::VoxelArena(size_t capacity) {
+  reserved = (capacity + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+#if defined(__linux__)
+  // without MAP_NORESERVE this fails up front, not on first touch, when too few huge pages are
+  // set aside
+  void* memory = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  hugePageBacked = memory != MAP_FAILED;
+  if (!hugePageBacked) {
+    // no reserved huge pages, ask for transparent ones instead
+    memory = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) {
+      panic("failed to reserve voxel arena");
+    }
+    hugePageBacked = madvise(memory, reserved, MADV_HUGEPAGE) == 0;
+  }
+  base = static_cast<uint8_t*>(memory);
+#elif defined(_WIN32)
+  // Large pages need a privilege most users do not have. Only the address range is reserved
+  // here, allocate commits regular pages as the bump pointer reaches them.
+  base = static_cast<uint8_t*>(VirtualAlloc(nullptr, reserved, MEM_RESERVE, PAGE_READWRITE));
+  if (base == nullptr) {
+    panic("failed to reserve voxel arena");
+  }
+#else
+  base = static_cast<uint8_t*>(std::malloc(reserved));
+  if (base == nullptr) {
+    panic("failed to reserve voxel arena");
+  }
+#endif
+#if !defined(_WIN32)
+  // the OS commits pages on first touch by itself
+  committed = reserved;
+#endif
+}
+
+VoxelArena::~VoxelArena() {
+#if defined(__linux__)
+  munmap(base, reserved);
+#elif defined(_WIN32)
+  VirtualFree(base, 0, MEM_RELEASE);
+#else
+  std::free(base);
+#endif
+}
+
+VoxelArena& VoxelArena::global() {
+  static VoxelArena arena{GLOBAL_CAPACITY};
+  return arena;
+}
+
+size_t VoxelArena::sizeClass(size_t bytes) {
+  size_t sizeClass = 0;
+  for (size_t block = MIN_BLOCK; block < bytes; block *= 2) {
+    sizeClass++;
+  }
+  return sizeClass;
+}
+
+bool VoxelArena::owns(const void* block) const {
+  const uint8_t* bytes = static_cast<const uint8_t*>(block);
+  return bytes >= base && bytes < base + reserved;
+}
+
+void* VoxelArena::allocate(size_t bytes) {
+  size_t index = sizeClass(bytes);
+  if (index < SIZE_CLASSES) {
+    std::lock_guard<std::mutex> lock{mutex};
+    if (freeLists[index] != nullptr) {
+      void* block = freeLists[index];
+      freeLists[index] = *static_cast<void**>(block);
+      return block;
+    }
+    size_t blockSize = MIN_BLOCK << index;
+    if (top + blockSize <= reserved && commit(top + blockSize)) {
+      void* block = base + top;
+      top += blockSize;
+      return block;
+    }
+    overflows++;
+  }
+  return ::operator new(bytes);
+}
+
+bool VoxelArena::commit(size_t end) {
+  if (end <= committed) {
+    return true;
+  }
+#if defined(_WIN32)
+  // a huge page worth at a time, so committing stays rare next to allocating
+  size_t grown = std::min(reserved, (end + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE);
+  if (VirtualAlloc(base + committed, grown - committed, MEM_COMMIT, PAGE_READWRITE) == nullptr) {
+    return false;
+  }
+  committed = grown;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void VoxelArena::free(void* block, size_t bytes) {
+  if (block == nullptr) {
+    return;
+  }
+  if (!owns(block)) {
+    ::operator delete(block);
+    return;
+  }
+  std::lock_guard<std::mutex> lock{mutex};
+  size_t index = sizeClass(bytes);
+  *static_cast<void**>(block) = freeLists[index];
+  freeLists[index] = block;
+}
+
+VoxelScratch& voxelScratch() {
+  struct ScratchBlock {
+    VoxelScratch* scratch;
+    ScratchBlock() : scratch{static_cast<VoxelScratch*>(VoxelArena::global().allocate(sizeof(VoxelScratch)))} {}
+    ~ScratchBlock() { VoxelArena::global().free(scratch, sizeof(VoxelScratch)); }
+  };
+  thread_local ScratchBlock block;
+  return *block.scratch;
+}
+}
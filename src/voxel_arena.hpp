@@ -0,0 +1,73 @@
+#pragma once
+
+#include "defines.hpp"
+#include "voxel.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace zx {
+
+// One large reservation made up front, backed by huge pages where the OS allows, handed out in
+// power of two size classes from 4 KiB to 1 MiB with a free list per class. Freed blocks are only
+// reused by their own class and nothing goes back to the OS before the arena is destroyed, so once
+// streaming has warmed the free lists an allocation is a list pop. Requests the arena cannot serve
+// fall back to the heap and are counted in overflowAllocations.
+class VoxelArena {
+ public:
+  static constexpr size_t MIN_BLOCK = 4 * 1024;
+  static constexpr size_t MAX_BLOCK = 1024 * 1024;
+  static constexpr size_t SIZE_CLASSES = 9;
+
+  explicit VoxelArena(size_t capacity);
+  ~VoxelArena();
+
+  VoxelArena(const VoxelArena &) = delete;
+  VoxelArena &operator=(const VoxelArena &) = delete;
+
+  // the arena shared by every chunk, reserved the first time it is used
+  static VoxelArena& global();
+
+  void* allocate(size_t bytes);
+  // bytes has to be what the block was allocated with
+  void free(void* block, size_t bytes);
+
+  bool hugePages() const { return hugePageBacked; }
+  size_t capacity() const { return reserved; }
+  // bytes carved from the reservation so far, free listed blocks included
+  size_t used() const { return top; }
+  size_t overflowAllocations() const { return overflows; }
+
+ private:
+  static size_t sizeClass(size_t bytes);
+  bool owns(const void* block) const;
+  // makes the first end bytes usable, false when the OS has no memory left for them
+  bool commit(size_t end);
+
+  uint8_t* base = nullptr;
+  size_t reserved = 0;
+  size_t top = 0;
+  // bytes from base that can be touched, the whole reservation except on Windows
+  size_t committed = 0;
+  bool hugePageBacked = false;
+  size_t overflows = 0;
+  // freed blocks of each class, linked through their first bytes
+  std::array<void*, SIZE_CLASSES> freeLists{};
+  std::mutex mutex;
+};
+
+// Chunk sized buffers for the calling thread, taken from the global arena the first time the
+// thread asks and kept for its lifetime. Each member has one user at a time: generation and
+// readChunk build voxels, encode sorts them into entries, RegionFile::readChunk inflates into
+// entries, Chunk::decodeVoxels and ChunkSnapshot::decode fill decoded and the border layers of
+// the neighbours.
+struct VoxelScratch {
+  std::array<Voxel, CHUNK_VOLUME> voxels;
+  std::array<uint8_t, CHUNK_VOLUME> entries;
+  std::array<Voxel, CHUNK_VOLUME> decoded;
+  std::array<std::array<Voxel, CHUNK_VOLUME>, 6> neighbours;
+};
+VoxelScratch& voxelScratch();
+}
@@ -0,0 +1,248 @@
+#include "voxel_palette.hpp"
+
+#include "voxel_arena.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
+
+namespace zx {
+namespace {
+// Every voxel of a chunk, going through the packed indices a byte at a time: a table built
+// from the palette turns each byte straight into the 8 / BITS voxels it holds. Reading the
+// words as bytes relies on a little-endian host.
+template <uint32_t BITS>
+void unpack(const uint64_t* words, const Voxel* palette, uint32_t paletteCount, Voxel* out) {
+  constexpr uint32_t perByte = 8 / BITS;
+  constexpr uint32_t mask = (1u << BITS) - 1;
+  std::array<std::array<Voxel, perByte>, 256> table;
+  for (uint32_t byte = 0; byte < 256; byte++) {
+    for (uint32_t k = 0; k < perByte; k++) {
+      // indices past the palette never occur in the data
+      uint32_t entry = (byte >> (k * BITS)) & mask;
+      table[byte][k] = entry < paletteCount ? palette[entry] : air;
+    }
+  }
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(words);
+  for (uint32_t b = 0; b < (CHUNK_VOLUME) / perByte; b++) {
+    std::memcpy(out + b * perByte, table[bytes[b]].data(), perByte);
+  }
+}
+
+template <uint32_t BITS>
+void pack(const uint8_t* entries, uint64_t* words) {
+  constexpr uint32_t perWord = 64 / BITS;
+  for (uint32_t w = 0; w < (CHUNK_VOLUME) / perWord; w++) {
+    uint64_t word = 0;
+    for (uint32_t k = 0; k < perWord; k++) {
+      word |= static_cast<uint64_t>(entries[w * perWord + k]) << (k * BITS);
+    }
+    words[w] = word;
+  }
+}
+}
+
+PalettedVoxels::PalettedVoxels() {}
+
+PalettedVoxels::~PalettedVoxels() {
+  VoxelArena::global().free(words, wordBytes(bits));
+}
+
+PalettedVoxels::PalettedVoxels(const PalettedVoxels& other) {
+  *this = other;
+}
+
+PalettedVoxels& PalettedVoxels::operator=(const PalettedVoxels& other) {
+  if (this == &other) {
+    return *this;
+  }
+  resize(other.bits);
+  palette = other.palette;
+  paletteCount = other.paletteCount;
+  if (bits != 0) {
+    std::memcpy(words, other.words, wordBytes(bits));
+  }
+  return *this;
+}
+
+PalettedVoxels::PalettedVoxels(PalettedVoxels&& other) noexcept {
+  *this = std::move(other);
+}
+
+PalettedVoxels& PalettedVoxels::operator=(PalettedVoxels&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+  VoxelArena::global().free(words, wordBytes(bits));
+  palette = other.palette;
+  paletteCount = other.paletteCount;
+  words = other.words;
+  bits = other.bits;
+  other.palette.fill(air);
+  other.paletteCount = 1;
+  other.words = nullptr;
+  other.bits = 0;
+  return *this;
+}
+
+uint32_t PalettedVoxels::bitsFor(size_t paletteSize) {
+  if (paletteSize <= 1) return 0;
+  if (paletteSize <= 2) return 1;
+  if (paletteSize <= 4) return 2;
+  return 4;
+}
+
+void PalettedVoxels::set(int x, int y, int z, Voxel voxel) {
+  uint32_t entry = static_cast<uint32_t>(std::find(palette.begin(), palette.begin() + paletteCount, voxel) - palette.begin());
+  if (entry == paletteCount) {
+    // entries are distinct types, so the palette cannot run out
+    palette[paletteCount++] = voxel;
+    uint32_t needed = bitsFor(paletteCount);
+    if (needed > bits) {
+      repack(needed);
+    }
+  }
+  if (bits == 0) {
+    return;
+  }
+  uint32_t bit = static_cast<uint32_t>(voxelIndex(x, y, z)) * bits;
+  uint64_t mask = ((1ull << bits) - 1) << (bit & 63);
+  words[bit >> 6] = (words[bit >> 6] & ~mask) | static_cast<uint64_t>(entry) << (bit & 63);
+}
+
+void PalettedVoxels::fill(Voxel voxel) {
+  resize(0);
+  palette[0] = voxel;
+  paletteCount = 1;
+}
+
+void PalettedVoxels::resize(uint32_t newBits) {
+  if (newBits != bits) {
+    VoxelArena::global().free(words, wordBytes(bits));
+    words = newBits != 0 ? static_cast<uint64_t*>(VoxelArena::global().allocate(wordBytes(newBits))) : nullptr;
+    bits = newBits;
+  }
+  if (bits != 0) {
+    std::memset(words, 0, wordBytes(bits));
+  }
+}
+
+void PalettedVoxels::repack(uint32_t newBits) {
+  uint64_t* packed = static_cast<uint64_t*>(VoxelArena::global().allocate(wordBytes(newBits)));
+  std::memset(packed, 0, wordBytes(newBits));
+  uint64_t mask = (1ull << bits) - 1;
+  for (uint32_t index = 0; index < CHUNK_VOLUME; index++) {
+    uint64_t entry = 0;
+    if (bits != 0) {
+      uint32_t bit = index * bits;
+      entry = (words[bit >> 6] >> (bit & 63)) & mask;
+    }
+    uint32_t bit = index * newBits;
+    packed[bit >> 6] |= entry << (bit & 63);
+  }
+  VoxelArena::global().free(words, wordBytes(bits));
+  words = packed;
+  bits = newBits;
+}
+
+void PalettedVoxels::decode(Voxel* out) const {
+  switch (bits) {
+    case 0:
+      std::fill(out, out + CHUNK_VOLUME, palette[0]);
+      break;
+    case 1:
+      unpack<1>(words, palette.data(), paletteCount, out);
+      break;
+    case 2:
+      unpack<2>(words, palette.data(), paletteCount, out);
+      break;
+    default:
+      unpack<4>(words, palette.data(), paletteCount, out);
+      break;
+  }
+}
+
+void PalettedVoxels::encode(const Voxel* in) {
+  // palette entries in order of first appearance
+  std::array<int, 256> lookup;
+  lookup.fill(-1);
+  std::array<Voxel, MAX_PALETTE> found{};
+  uint32_t foundCount = 0;
+  std::array<uint8_t, CHUNK_VOLUME>& entries = voxelScratch().entries;
+  for (uint32_t index = 0; index < CHUNK_VOLUME; index++) {
+    Voxel voxel = in[index];
+    if (lookup[voxel] < 0) {
+      lookup[voxel] = static_cast<int>(foundCount);
+      found[foundCount++] = voxel;
+    }
+    entries[index] = static_cast<uint8_t>(lookup[voxel]);
+  }
+
+  resize(bitsFor(foundCount));
+  palette = found;
+  paletteCount = foundCount;
+  switch (bits) {
+    case 0:
+      break;
+    case 1:
+      pack<1>(entries.data(), words);
+      break;
+    case 2:
+      pack<2>(entries.data(), words);
+      break;
+    default:
+      pack<4>(entries.data(), words);
+      break;
+  }
+}
+
+void PalettedVoxels::decodeLayer(int axis, int slice, Voxel* out) const {
+  int u = (axis + 1) % 3;
+  int v = (axis + 2) % 3;
+  glm::ivec3 pos;
+  pos[axis] = slice;
+  for (int j = 0; j < CHUNK_SIZE; j++) {
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+      pos[u] = i;
+      pos[v] = j;
+      int index = voxelIndex(pos.x, pos.y, pos.z);
+      out[index] = get(index);
+    }
+  }
+}
+
+void PalettedVoxels::serialize(uint8_t* out) const {
+  out[0] = static_cast<uint8_t>(bits);
+  out[1] = static_cast<uint8_t>(paletteCount);
+  std::memcpy(out + 2, palette.data(), paletteCount);
+  if (bits != 0) {
+    std::memcpy(out + 2 + paletteCount, words, wordBytes(bits));
+  }
+}
+
+bool PalettedVoxels::deserialize(const uint8_t* in, size_t size) {
+  if (size < 2) {
+    return false;
+  }
+  uint32_t newBits = in[0];
+  uint32_t newCount = in[1];
+  if (newCount == 0 || newCount > MAX_PALETTE || newBits != bitsFor(newCount) ||
+      size != 2 + newCount + wordBytes(newBits)) {
+    return false;
+  }
+  for (uint32_t entry = 0; entry < newCount; entry++) {
+    if (in[2 + entry] >= VOXEL_TYPES) {
+      return false;
+    }
+  }
+  resize(newBits);
+  palette.fill(air);
+  std::memcpy(palette.data(), in + 2, newCount);
+  paletteCount = newCount;
+  if (bits != 0) {
+    std::memcpy(words, in + 2 + newCount, wordBytes(bits));
+  }
+  return true;
+}
+}
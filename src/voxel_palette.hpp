@@ -0,0 +1,75 @@
+#pragma once
+
+#include "defines.hpp"
+#include "voxel.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace zx {
+
+// Voxels of one chunk as a palette of the types in it plus a bit-packed palette index per voxel,
+// indexed by voxelIndex. The width grows with the palette: 0 bits while the chunk holds a single
+// type, then 1, 2 or 4, so an index never straddles two words. The usual chunk of two to four
+// types takes 4 to 8 KiB instead of 32 KiB. The palette lives inline and the indices come from
+// VoxelArena::global(), so a chunk changing width never touches the general heap.
+class PalettedVoxels {
+ public:
+  static constexpr size_t MAX_PALETTE = 16;
+  static_assert(VOXEL_TYPES <= MAX_PALETTE, "every voxel type has to fit in one palette");
+
+  PalettedVoxels();
+  ~PalettedVoxels();
+  PalettedVoxels(const PalettedVoxels& other);
+  PalettedVoxels& operator=(const PalettedVoxels& other);
+  // takes the packed indices over, other is left holding a single air voxel type
+  PalettedVoxels(PalettedVoxels&& other) noexcept;
+  PalettedVoxels& operator=(PalettedVoxels&& other) noexcept;
+
+  Voxel get(int x, int y, int z) const { return get(voxelIndex(x, y, z)); }
+  Voxel get(int index) const {
+    if (bits == 0) {
+      return palette[0];
+    }
+    uint32_t bit = static_cast<uint32_t>(index) * bits;
+    return palette[(words[bit >> 6] >> (bit & 63)) & ((1ull << bits) - 1)];
+  }
+  // a type not yet in the palette widens every index when it no longer fits
+  void set(int x, int y, int z, Voxel voxel);
+  void fill(Voxel voxel);
+
+  // bulk conversion to and from CHUNK_VOLUME bytes in voxelIndex order, encode also drops
+  // palette entries that set left unused and packs through voxelScratch().entries
+  void decode(Voxel* out) const;
+  void encode(const Voxel* in);
+  // decodes only the voxels with coordinate slice along axis, into their places in out
+  void decodeLayer(int axis, int slice, Voxel* out) const;
+
+  // The width, palette and packed indices as bytes, for RegionFile. The indices keep the
+  // voxelIndex order of this build and the byte order of the host.
+  size_t serializedSize() const { return 2 + paletteCount + wordBytes(bits); }
+  void serialize(uint8_t* out) const;
+  // false, leaving the voxels as they were, when the bytes are not a serialized set
+  bool deserialize(const uint8_t* in, size_t size);
+
+  // a single type for the whole chunk, held without any packed indices
+  bool isUniform() const { return bits == 0; }
+  size_t paletteSize() const { return paletteCount; }
+  uint32_t bitsPerVoxel() const { return bits; }
+  // bytes held by the palette and the packed indices
+  size_t memoryUsage() const { return sizeof(palette) + wordBytes(bits); }
+
+ private:
+  static uint32_t bitsFor(size_t paletteSize);
+  static size_t wordBytes(uint32_t bits) { return static_cast<size_t>(CHUNK_VOLUME) * bits / 8; }
+  // swaps the packed indices for zeroed ones of the new width
+  void resize(uint32_t newBits);
+  void repack(uint32_t newBits);
+
+  std::array<Voxel, MAX_PALETTE> palette{};
+  uint32_t paletteCount = 1;
+  uint64_t* words = nullptr;
+  uint32_t bits = 0;
+};
+}
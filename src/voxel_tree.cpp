@@ -0,0 +1,439 @@
+#include "voxel_tree.hpp"
+
+#include "voxel_arena.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace zx {
+namespace {
+bool contains(const glm::ivec3& min, const glm::ivec3& max, const glm::ivec3& pos) {
+  return pos.x >= min.x && pos.y >= min.y && pos.z >= min.z && pos.x < max.x && pos.y < max.y && pos.z < max.z;
+}
+}
+
+VoxelTree::VoxelTree(int depth) : depth{depth} {
+  if (depth < 1 || depth > MAX_DEPTH) {
+    panic("voxel tree depth out of range");
+  }
+}
+
+const VoxelTree::Node* VoxelTree::findRoot(const glm::ivec3& root) const {
+  auto found = rootIndices.find(RootKey{root.x, root.y, root.z});
+  return found != rootIndices.end() ? &roots[found->second] : nullptr;
+}
+
+uint32_t VoxelTree::acquireRoot(const glm::ivec3& root) {
+  auto found = rootIndices.find(RootKey{root.x, root.y, root.z});
+  if (found != rootIndices.end()) {
+    return found->second;
+  }
+  uint32_t fresh;
+  if (!freeRoots.empty()) {
+    fresh = freeRoots.back();
+    freeRoots.pop_back();
+    roots[fresh] = Node{};
+  } else {
+    fresh = static_cast<uint32_t>(roots.size());
+    roots.emplace_back();
+  }
+  rootIndices.emplace(RootKey{root.x, root.y, root.z}, fresh);
+  return fresh;
+}
+
+uint32_t VoxelTree::descend(const glm::ivec3& pos, int level) {
+  uint32_t index = acquireRoot(rootOf(pos)) | ROOT;
+  glm::ivec3 local = pos - rootOf(pos) * rootSize();
+  for (int current = depth; current > level; current--) {
+    if (node(index).children == NO_CHILDREN) {
+      split(index, current);
+    }
+    int shift = 2 * (current - 1);
+    index = node(index).children +
+            childIndex({(local.x >> shift) & 3, (local.y >> shift) & 3, (local.z >> shift) & 3});
+  }
+  return index;
+}
+
+uint32_t VoxelTree::allocateNodes() {
+  if (!freeNodeBlocks.empty()) {
+    uint32_t children = freeNodeBlocks.back();
+    freeNodeBlocks.pop_back();
+    return children;
+  }
+  uint32_t children = static_cast<uint32_t>(nodes.size());
+  nodes.resize(nodes.size() + 64);
+  return children;
+}
+
+uint32_t VoxelTree::allocateLeaf() {
+  if (!freeLeaves.empty()) {
+    uint32_t leaf = freeLeaves.back();
+    freeLeaves.pop_back();
+    return leaf;
+  }
+  leaves.emplace_back();
+  return static_cast<uint32_t>(leaves.size() - 1);
+}
+
+Voxel VoxelTree::get(const glm::ivec3& pos) const {
+  const Node* current = findRoot(rootOf(pos));
+  if (current == nullptr) {
+    return air;
+  }
+  glm::ivec3 local = pos - rootOf(pos) * rootSize();
+  for (int level = depth; level > 0; level--) {
+    if (current->children == NO_CHILDREN) {
+      return current->voxel;
+    }
+    int shift = 2 * (level - 1);
+    int child = childIndex({(local.x >> shift) & 3, (local.y >> shift) & 3, (local.z >> shift) & 3});
+    if (level == 1) {
+      return leaves[current->children][child];
+    }
+    current = &nodes[current->children + child];
+  }
+  return current->voxel;
+}
+
+void VoxelTree::set(const glm::ivec3& pos, Voxel voxel) {
+  fill(pos, pos + 1, voxel);
+}
+
+void VoxelTree::fill(const glm::ivec3& min, const glm::ivec3& max, Voxel voxel) {
+  if (min.x >= max.x || min.y >= max.y || min.z >= max.z) {
+    return;
+  }
+  glm::ivec3 first = rootOf(min);
+  glm::ivec3 last = rootOf(max - 1);
+  for (int z = first.z; z <= last.z; z++) {
+    for (int y = first.y; y <= last.y; y++) {
+      for (int x = first.x; x <= last.x; x++) {
+        // writing air where there is nothing changes nothing
+        if (voxel == air && findRoot({x, y, z}) == nullptr) {
+          continue;
+        }
+        uint32_t index = acquireRoot({x, y, z});
+        fillNode(index | ROOT, depth, glm::ivec3{x, y, z} * rootSize(), min, max, voxel);
+        // a cube of nothing but air is as good as no cube
+        if (roots[index].children == NO_CHILDREN && roots[index].voxel == air) {
+          freeRoots.push_back(index);
+          rootIndices.erase(RootKey{x, y, z});
+        }
+      }
+    }
+  }
+}
+
+bool VoxelTree::uniform(const glm::ivec3& min, const glm::ivec3& max, Voxel& voxel) const {
+  bool seen = false;
+  glm::ivec3 first = rootOf(min);
+  glm::ivec3 last = rootOf(max - 1);
+  for (int z = first.z; z <= last.z; z++) {
+    for (int y = first.y; y <= last.y; y++) {
+      for (int x = first.x; x <= last.x; x++) {
+        const Node* root = findRoot({x, y, z});
+        if (root == nullptr) {
+          if (seen && voxel != air) {
+            return false;
+          }
+          voxel = air;
+          seen = true;
+        } else if (!uniformNode(*root, depth, glm::ivec3{x, y, z} * rootSize(), min, max, voxel, seen)) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool VoxelTree::uniformNode(const Node& current, int level, const glm::ivec3& nodeMin, const glm::ivec3& min,
+                            const glm::ivec3& max, Voxel& voxel, bool& seen) const {
+  int extent = 1 << (2 * level);
+  glm::ivec3 lo = glm::max(min, nodeMin);
+  glm::ivec3 hi = glm::min(max, nodeMin + extent);
+  if (lo.x >= hi.x || lo.y >= hi.y || lo.z >= hi.z) {
+    return true;
+  }
+  if (current.children == NO_CHILDREN) {
+    if (seen && voxel != current.voxel) {
+      return false;
+    }
+    voxel = current.voxel;
+    seen = true;
+    return true;
+  }
+
+  int childExtent = extent / 4;
+  for (int child = 0; child < 64; child++) {
+    glm::ivec3 childMin = nodeMin + childOffset(child) * childExtent;
+    if (level == 1) {
+      if (!contains(lo, hi, childMin)) {
+        continue;
+      }
+      Voxel leafVoxel = leaves[current.children][child];
+      if (seen && voxel != leafVoxel) {
+        return false;
+      }
+      voxel = leafVoxel;
+      seen = true;
+    } else if (!uniformNode(nodes[current.children + child], level - 1, childMin, lo, hi, voxel, seen)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void VoxelTree::fillNode(uint32_t index, int level, const glm::ivec3& nodeMin, const glm::ivec3& min,
+                         const glm::ivec3& max, Voxel voxel) {
+  int extent = 1 << (2 * level);
+  glm::ivec3 lo = glm::max(min, nodeMin);
+  glm::ivec3 hi = glm::min(max, nodeMin + extent);
+  if (lo.x >= hi.x || lo.y >= hi.y || lo.z >= hi.z) {
+    return;
+  }
+
+  if (lo == nodeMin && hi == nodeMin + extent) {
+    Node& covered = node(index);
+    if (covered.children != NO_CHILDREN) {
+      release(covered.children, level);
+      covered.children = NO_CHILDREN;
+    }
+    covered.voxel = voxel;
+    return;
+  }
+
+  if (node(index).children == NO_CHILDREN) {
+    if (node(index).voxel == voxel) {
+      return;
+    }
+    split(index, level);
+  }
+
+  // the pools may grow below, so children are looked up by index every time
+  uint32_t children = node(index).children;
+  int childExtent = extent / 4;
+  for (int child = 0; child < 64; child++) {
+    glm::ivec3 childMin = nodeMin + childOffset(child) * childExtent;
+    if (level == 1) {
+      if (contains(lo, hi, childMin)) {
+        leaves[children][child] = voxel;
+      }
+    } else {
+      fillNode(children + child, level - 1, childMin, lo, hi, voxel);
+    }
+  }
+  collapse(index, level);
+}
+
+void VoxelTree::split(uint32_t index, int level) {
+  Voxel voxel = node(index).voxel;
+  uint32_t children;
+  if (level == 1) {
+    children = allocateLeaf();
+    leaves[children].fill(voxel);
+  } else {
+    children = allocateNodes();
+    for (int child = 0; child < 64; child++) {
+      nodes[children + child] = Node{NO_CHILDREN, voxel};
+    }
+  }
+  node(index).children = children;
+}
+
+void VoxelTree::collapse(uint32_t index, int level) {
+  uint32_t children = node(index).children;
+  Voxel voxel;
+  if (level == 1) {
+    const Leaf& leaf = leaves[children];
+    voxel = leaf[0];
+    for (Voxel child : leaf) {
+      if (child != voxel) {
+        return;
+      }
+    }
+  } else {
+    voxel = nodes[children].voxel;
+    for (int child = 0; child < 64; child++) {
+      const Node& current = nodes[children + child];
+      if (current.children != NO_CHILDREN || current.voxel != voxel) {
+        return;
+      }
+    }
+  }
+  release(children, level);
+  node(index).children = NO_CHILDREN;
+  node(index).voxel = voxel;
+}
+
+void VoxelTree::release(uint32_t children, int level) {
+  if (level == 1) {
+    freeLeaves.push_back(children);
+    return;
+  }
+  for (int child = 0; child < 64; child++) {
+    if (nodes[children + child].children != NO_CHILDREN) {
+      release(nodes[children + child].children, level - 1);
+      nodes[children + child].children = NO_CHILDREN;
+    }
+  }
+  freeNodeBlocks.push_back(children);
+}
+
+void VoxelTree::forEachSolid(const glm::ivec3& min, const glm::ivec3& max, const RegionVisitor& visit) const {
+  if (min.x >= max.x || min.y >= max.y || min.z >= max.z) {
+    return;
+  }
+  glm::ivec3 first = rootOf(min);
+  glm::ivec3 last = rootOf(max - 1);
+  for (int z = first.z; z <= last.z; z++) {
+    for (int y = first.y; y <= last.y; y++) {
+      for (int x = first.x; x <= last.x; x++) {
+        const Node* root = findRoot({x, y, z});
+        if (root != nullptr) {
+          visitNode(*root, depth, glm::ivec3{x, y, z} * rootSize(), min, max, visit);
+        }
+      }
+    }
+  }
+}
+
+void VoxelTree::visitNode(const Node& current, int level, const glm::ivec3& nodeMin, const glm::ivec3& min,
+                          const glm::ivec3& max, const RegionVisitor& visit) const {
+  int extent = 1 << (2 * level);
+  glm::ivec3 lo = glm::max(min, nodeMin);
+  glm::ivec3 hi = glm::min(max, nodeMin + extent);
+  if (lo.x >= hi.x || lo.y >= hi.y || lo.z >= hi.z) {
+    return;
+  }
+  if (current.children == NO_CHILDREN) {
+    if (current.voxel != air) {
+      visit(lo, hi - lo, current.voxel);
+    }
+    return;
+  }
+
+  int childExtent = extent / 4;
+  for (int child = 0; child < 64; child++) {
+    glm::ivec3 childMin = nodeMin + childOffset(child) * childExtent;
+    if (level == 1) {
+      Voxel voxel = leaves[current.children][child];
+      if (voxel != air && contains(lo, hi, childMin)) {
+        visit(childMin, glm::ivec3{1}, voxel);
+      }
+    } else {
+      visitNode(nodes[current.children + child], level - 1, childMin, lo, hi, visit);
+    }
+  }
+}
+
+void VoxelTree::writeChunk(const glm::ivec3& chunkPos, const PalettedVoxels& voxels) {
+  glm::ivec3 chunkMin = chunkPos * CHUNK_SIZE;
+  if (voxels.isUniform()) {
+    fill(chunkMin, chunkMin + CHUNK_SIZE, voxels.get(0));
+    return;
+  }
+
+  std::array<Voxel, CHUNK_VOLUME>& decoded = voxelScratch().voxels;
+  voxels.decode(decoded.data());
+  if (depth < 2) {
+    // roots smaller than the nodes below, runs of one type along x go in as a single box
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+      for (int y = 0; y < CHUNK_SIZE; y++) {
+        for (int x = 0; x < CHUNK_SIZE;) {
+          Voxel voxel = decoded[voxelIndex(x, y, z)];
+          int end = x + 1;
+          while (end < CHUNK_SIZE && decoded[voxelIndex(end, y, z)] == voxel) {
+            end++;
+          }
+          fill(chunkMin + glm::ivec3{x, y, z}, chunkMin + glm::ivec3{end, y + 1, z + 1}, voxel);
+          x = end;
+        }
+      }
+    }
+    return;
+  }
+
+  // The chunk is 2x2x2 nodes of level 2, 16 voxels per side. Each is gathered into its 64 leaves
+  // first, then goes in as a single fill when it holds one type, else as a fresh node block
+  // replacing whatever the node held. Its parents keep at least one child with children, so
+  // none of them can collapse.
+  constexpr int NODE_SIZE = 16;
+  std::array<Leaf, 64> gathered;
+  std::array<bool, 64> uniformLeaf;
+  for (int block = 0; block < 8; block++) {
+    glm::ivec3 blockOffset = glm::ivec3{block & 1, (block >> 1) & 1, block >> 2} * NODE_SIZE;
+    bool uniformBlock = true;
+    for (int child = 0; child < 64; child++) {
+      glm::ivec3 leafOffset = blockOffset + childOffset(child) * 4;
+      Leaf& leaf = gathered[child];
+      for (int voxel = 0; voxel < 64; voxel++) {
+        glm::ivec3 pos = leafOffset + childOffset(voxel);
+        leaf[voxel] = decoded[voxelIndex(pos.x, pos.y, pos.z)];
+      }
+      uniformLeaf[child] = std::all_of(leaf.begin(), leaf.end(), [&](Voxel voxel) { return voxel == leaf[0]; });
+      uniformBlock = uniformBlock && uniformLeaf[child] && leaf[0] == gathered[0][0];
+    }
+
+    glm::ivec3 blockMin = chunkMin + blockOffset;
+    if (uniformBlock) {
+      fill(blockMin, blockMin + NODE_SIZE, gathered[0][0]);
+      continue;
+    }
+    uint32_t index = descend(blockMin, 2);
+    if (node(index).children != NO_CHILDREN) {
+      release(node(index).children, 2);
+    }
+    // the pools may grow here, so the node is looked up again afterwards
+    uint32_t children = allocateNodes();
+    for (int child = 0; child < 64; child++) {
+      if (uniformLeaf[child]) {
+        nodes[children + child] = Node{NO_CHILDREN, gathered[child][0]};
+      } else {
+        uint32_t leaf = allocateLeaf();
+        leaves[leaf] = gathered[child];
+        nodes[children + child] = Node{leaf, air};
+      }
+    }
+    node(index).children = children;
+  }
+}
+
+void VoxelTree::readChunk(const glm::ivec3& chunkPos, PalettedVoxels& voxels) const {
+  glm::ivec3 chunkMin = chunkPos * CHUNK_SIZE;
+  Voxel voxel;
+  if (uniform(chunkMin, chunkMin + CHUNK_SIZE, voxel)) {
+    voxels.fill(voxel);
+    return;
+  }
+  std::array<Voxel, CHUNK_VOLUME>& decoded = voxelScratch().voxels;
+  readChunk(chunkPos, decoded.data());
+  voxels.encode(decoded.data());
+}
+
+void VoxelTree::readChunk(const glm::ivec3& chunkPos, Voxel* voxels) const {
+  glm::ivec3 chunkMin = chunkPos * CHUNK_SIZE;
+  std::fill(voxels, voxels + CHUNK_VOLUME, air);
+  forEachSolid(chunkMin, chunkMin + CHUNK_SIZE, [&](const glm::ivec3& min, const glm::ivec3& size, Voxel voxel) {
+    glm::ivec3 local = min - chunkMin;
+    for (int z = local.z; z < local.z + size.z; z++) {
+      for (int y = local.y; y < local.y + size.y; y++) {
+        for (int x = local.x; x < local.x + size.x; x++) {
+          voxels[voxelIndex(x, y, z)] = voxel;
+        }
+      }
+    }
+  });
+}
+
+size_t VoxelTree::nodeCount() const {
+  return rootIndices.size() + nodes.size() - freeNodeBlocks.size() * 64 + (leaves.size() - freeLeaves.size()) * 64;
+}
+
+size_t VoxelTree::memoryUsage() const {
+  return (roots.capacity() + nodes.capacity()) * sizeof(Node) + leaves.capacity() * sizeof(Leaf) +
+         (freeRoots.capacity() + freeNodeBlocks.capacity() + freeLeaves.capacity()) * sizeof(uint32_t);
+}
+}
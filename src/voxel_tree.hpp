@@ -0,0 +1,117 @@
+#pragma once
+
+#include "defines.hpp"
+#include "voxel.hpp"
+#include "voxel_palette.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace zx {
+
+// Sparse 64-tree over all of world voxel space, split into cubes of 4^depth voxels per side
+// with a root node each. A root is only made once something other than air is written into its
+// cube and dropped again once the cube holds nothing but air, so any coordinate is covered and
+// only the cubes with voxels in them cost memory. Every node splits into 4x4x4 children and a
+// node whose region holds a single type keeps only that type, so the air above the terrain and
+// the rock below it collapse into a few nodes while detail costs one byte per voxel at the
+// bottom level. Child blocks are pooled and recycled when a region collapses again.
+class VoxelTree {
+ public:
+  // min and size of a uniform region, in world voxels
+  using RegionVisitor = std::function<void(const glm::ivec3& min, const glm::ivec3& size, Voxel voxel)>;
+
+  explicit VoxelTree(int depth);
+
+  // voxels nothing was written to read as air
+  Voxel get(const glm::ivec3& pos) const;
+  void set(const glm::ivec3& pos, Voxel voxel);
+  // every voxel in [min, max), nodes covered whole are collapsed instead of visited
+  void fill(const glm::ivec3& min, const glm::ivec3& max, Voxel voxel);
+  // whether every voxel in [min, max) is the same type, which then goes in voxel
+  bool uniform(const glm::ivec3& min, const glm::ivec3& max, Voxel& voxel) const;
+
+  // Visits the uniform regions that are not air and overlap [min, max), clipped to the box.
+  // Air nodes are skipped whole, so empty space costs one step per node.
+  void forEachSolid(const glm::ivec3& min, const glm::ivec3& max, const RegionVisitor& visit) const;
+
+  // Copy one chunk at a chunk position in or out of the tree. writeChunk builds each 16 voxel
+  // node of the chunk bottom up and swaps it in whole, so a chunk costs one pass over its voxels
+  // instead of a fill per run.
+  void writeChunk(const glm::ivec3& chunkPos, const PalettedVoxels& voxels);
+  void readChunk(const glm::ivec3& chunkPos, PalettedVoxels& voxels) const;
+  // one chunk in voxelIndex order, CHUNK_VOLUME voxels
+  void readChunk(const glm::ivec3& chunkPos, Voxel* voxels) const;
+
+  // voxels per side of the cube under a root
+  int rootSize() const { return 1 << (2 * depth); }
+  size_t rootCount() const { return rootIndices.size(); }
+  // nodes and leaf voxels held by live child blocks, the pooled free ones excluded
+  size_t nodeCount() const;
+  size_t memoryUsage() const;
+
+  static constexpr int MAX_DEPTH = 15;
+
+ private:
+  static constexpr uint32_t NO_CHILDREN = ~0u;
+  // set in the index of a node in roots rather than nodes
+  static constexpr uint32_t ROOT = 1u << 31;
+  using RootKey = std::tuple<int, int, int>;
+
+  struct Node {
+    // first of 64 children in nodes, or in leaves at level 1 where the children are voxels
+    uint32_t children = NO_CHILDREN;
+    // the whole region while there are no children
+    Voxel voxel = air;
+  };
+  using Leaf = std::array<Voxel, 64>;
+
+  Node& node(uint32_t index) { return index & ROOT ? roots[index & ~ROOT] : nodes[index]; }
+  const Node& node(uint32_t index) const { return index & ROOT ? roots[index & ~ROOT] : nodes[index]; }
+  // the cube of a root, in units of rootSize
+  glm::ivec3 rootOf(const glm::ivec3& pos) const { return {pos.x >> (2 * depth), pos.y >> (2 * depth), pos.z >> (2 * depth)}; }
+  // nullptr where the cube holds nothing but air
+  const Node* findRoot(const glm::ivec3& root) const;
+  // the entry in roots of the cube, a new air root when it has none
+  uint32_t acquireRoot(const glm::ivec3& root);
+  // the node at level covering pos, splitting the nodes above it on the way down
+  uint32_t descend(const glm::ivec3& pos, int level);
+  // a free block of 64 nodes or a free leaf, contents left as they were
+  uint32_t allocateNodes();
+  uint32_t allocateLeaf();
+  static int childIndex(const glm::ivec3& offset) { return offset.x | offset.y << 2 | offset.z << 4; }
+  static glm::ivec3 childOffset(int child) { return {child & 3, (child >> 2) & 3, child >> 4}; }
+
+  void fillNode(uint32_t index, int level, const glm::ivec3& nodeMin, const glm::ivec3& min,
+                const glm::ivec3& max, Voxel voxel);
+  void visitNode(const Node& current, int level, const glm::ivec3& nodeMin, const glm::ivec3& min,
+                 const glm::ivec3& max, const RegionVisitor& visit) const;
+  // false once a voxel in [min, max) differs from voxel, the first one seen when seen is false
+  bool uniformNode(const Node& current, int level, const glm::ivec3& nodeMin, const glm::ivec3& min,
+                   const glm::ivec3& max, Voxel& voxel, bool& seen) const;
+  // gives the node 64 children of its own type
+  void split(uint32_t index, int level);
+  // turns the node back into a single type if all its children are that type
+  void collapse(uint32_t index, int level);
+  void release(uint32_t children, int level);
+
+  int depth;
+  // the roots of the cubes with voxels in them, by cube, and the free entries of roots
+  std::map<RootKey, uint32_t> rootIndices;
+  std::vector<Node> roots;
+  std::vector<uint32_t> freeRoots;
+  std::vector<Node> nodes;
+  std::vector<Leaf> leaves;
+  std::vector<uint32_t> freeNodeBlocks;
+  std::vector<uint32_t> freeLeaves;
+};
+}
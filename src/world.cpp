@@ -1,127 +1,636 @@
 #include "world.hpp"
+#include "voxel_arena.hpp"
 #include "zx_game_object.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 namespace zx{
 
-World::World(ZxDevice& zxDevice) : zxDevice{zxDevice}{
-  glm::vec3 pos = {0.f, 0.f, 0.f};
-  std::unique_ptr<ZxGameObject> chunk_game_object = ZxGameObject::create_chunk_object(zxDevice, pos);
-  chunks.push_back(chunk_game_object);
+float generateSeed(const std::string& input){
+    std::hash<std::string> strhash;
+
+    float seed_float;
+    uint32_t hash = strhash(input);
+    std::memcpy(&seed_float, &hash, sizeof(float));
+    return seed_float;
 }
-World::~World(){}
 
-float rounded(const glm::vec2& coord){
-    auto bump = [](float t) { return glm::max(0.0f, 1.0f - std::pow(t, 6.0f)); };
-    float b = bump(coord.x) * bump(coord.y);
-    return b * 0.9f;
+World::World(ZxDevice& zxDevice, unsigned workerCount)
+    : zxDevice{zxDevice}, terrain{static_cast<int>(generateSeed("my seed")), 0}, chunkPool{zxDevice},
+      jobs{workerCount}{
+  reserveChunks();
+#ifdef ZX_VOXEL_TREE
+  enableVoxelTree();
+#endif
+}
+World::~World(){
+  // edits would be lost otherwise, but a failed save must not take the shutdown down with it
+  try {
+    saveChunks();
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
 }
 
-float getNoiseAt(const glm::vec2& voxel_position, const glm::vec2& chunk_position,
-                  const NoiseSettings& settings, int seed){
-  float voxel_x = voxel_position.x + chunk_position.x * CHUNK_SIZE;
-  float voxel_z = voxel_position.y + chunk_position.y * CHUNK_SIZE;
+int floorDiv(int a, int b){
+    return a / b - (a % b < 0 ? 1 : 0);
+}
 
-  float value = 0;
-  float accumulated_amplitudes = 0;
-  for (int i = 0; i < settings.octaves; i++) {
-      float frequency = glm::pow(2.0f, i);
-      float amplitude = glm::pow(settings.roughness, i);
+glm::ivec3 chunkOf(const glm::ivec3& voxel_pos){
+    return {floorDiv(voxel_pos.x, CHUNK_SIZE), floorDiv(voxel_pos.y, CHUNK_SIZE),
+            floorDiv(voxel_pos.z, CHUNK_SIZE)};
+}
 
-      float x = voxel_x * frequency / settings.smoothness;
-      float y = voxel_z * frequency / settings.smoothness;
+void World::pregenerate(const glm::ivec2& center, int radius){
+    for (int z = -radius; z <= radius; z++) {
+      for (int x = -radius; x <= radius; x++) {
+        glm::ivec2 column = center + glm::ivec2{x, z};
+        if (x * x + z * z <= radius * radius && !columnLoaded(column)) {
+          loadColumn(column);
+        }
+      }
+    }
+    // collecting generated chunks submits their mesh jobs, so go on until a round submits nothing
+    for (;;) {
+      jobs.wait();
+      if (!hasFinishedJobs()) {
+        break;
+      }
+      collectJobs(std::numeric_limits<int>::max());
+      // no frame submits the uploads yet, so their staging buffers would pile up
+      zxDevice.flushUploads();
+    }
+}
 
-      float noise = glm::simplex(glm::vec3{seed + x, seed + y, seed});
-      noise = (noise + 1.0f) / 2.0f;
-      value += noise * amplitude;
-      accumulated_amplitudes += amplitude;
-  }
-  return value / accumulated_amplitudes;
+bool World::columnLoaded(const glm::ivec2& column) const {
+    // the unload sweep goes chunk by chunk, so a column can be partly gone
+    for (int y = 0; y < COLUMN_HEIGHT; y++) {
+      if (!chunks.contains({column.x, y, column.y})) {
+        return false;
+      }
+    }
+    return true;
 }
 
-void World::createChunkHeightMap(const glm::vec3& position, int worldSize, int seed){
+void World::loadColumn(const glm::ivec2& column){
+    for (int y = 0; y < COLUMN_HEIGHT; y++) {
+      // a chunk still loaded may hold edits and have jobs in flight, it stays as it is
+      if (chunks.contains({column.x, y, column.y})) {
+        continue;
+      }
+      requestLoad(acquireChunk({column.x, y, column.y}));
+    }
+}
 
-    const float world_size = static_cast<float>(world_size) * CHUNK_SIZE;
+void World::requestLoad(Chunk& chunk){
+    if (spareGenerated.empty()) {
+      generatedResults.push_back(std::make_unique<GeneratedChunk>());
+      spareGenerated.push_back(generatedResults.back().get());
+    }
+    GeneratedChunk* job = spareGenerated.back();
+    spareGenerated.pop_back();
+    job->ticket = ++nextTicket;
+    job->position = chunk.position;
+    auto saved = saving.find({chunk.position.x, chunk.position.y, chunk.position.z});
+    job->source = saved != saving.end() ? saved->second : nullptr;
+    // opened here, the workers only read regions that already exist
+    job->region = &region(chunk.position);
+    chunk.generateTicket = job->ticket;
+    jobs.submit([this, job] {
+      // an explored chunk comes back from its region file, no noise needed
+      if (job->source) {
+        job->voxels = *job->source;
+        job->loaded = true;
+      } else {
+        job->loaded = job->region->readChunk(job->position, job->voxels);
+      }
+      if (!job->loaded) {
+        TerrainGenerator::HeightMap heights;
+        terrain.heightMap({job->position.x, job->position.z}, heights);
+        terrain.fillChunk(job->position, heights, job->voxels);
+      }
+      std::lock_guard<std::mutex> lock{finishedMutex};
+      generated.push_back(job);
+    });
+}
 
-    NoiseSettings firstNoise;
-    firstNoise.amplitude = 105;
-    firstNoise.octaves = 6;
-    firstNoise.smoothness = 205.f;
-    firstNoise.roughness = 0.58f;
-    firstNoise.offset = 18;
+void World::requestSave(const glm::ivec3& chunk_pos, std::shared_ptr<const PalettedVoxels> voxels){
+    if (spareSaved.empty()) {
+      savedResults.push_back(std::make_unique<SavedChunk>());
+      spareSaved.push_back(savedResults.back().get());
+    }
+    SavedChunk* job = spareSaved.back();
+    spareSaved.pop_back();
+    job->ticket = ++nextTicket;
+    job->position = chunk_pos;
+    job->region = &region(chunk_pos);
+    // a later save of the same chunk replaces it, its ticket comes after this one
+    saving[{chunk_pos.x, chunk_pos.y, chunk_pos.z}] = voxels;
+    job->voxels = std::move(voxels);
+    jobs.submit([this, job] {
+      RegionFile::compress(*job->voxels, job->compressed);
+      std::lock_guard<std::mutex> lock{finishedMutex};
+      saved.push_back(job);
+    });
+}
 
-    NoiseSettings secondNoise;
-    secondNoise.amplitude = 20;
-    secondNoise.octaves = 4;
-    secondNoise.smoothness = 200;
-    secondNoise.roughness = 0.45f;
-    secondNoise.offset = 0;
+void World::requestMesh(Chunk& chunk, const ChunkMesher::SliceMasks& slices){
+    if (spareMeshed.empty()) {
+      meshedResults.push_back(std::make_unique<MeshedChunk>());
+      spareMeshed.push_back(meshedResults.back().get());
+    }
+    MeshedChunk* job = spareMeshed.back();
+    spareMeshed.pop_back();
+    job->ticket = ++nextTicket;
+    job->position = chunk.position;
+    job->snapshot = chunk.snapshot(getNeighbours(chunk.position));
+    job->slices = slices;
+    // the layers of a GPU meshed chunk do not hold its faces, so nothing can be kept
+    if (chunk.gpuMeshed) {
+      job->slices.fill(ChunkMesher::ALL_SLICES);
+    }
+    // every slice starts over from the cleared mesher, with all of it changed from face 0 on
+    bool everySlice = std::all_of(job->slices.begin(), job->slices.end(),
+                                  [](uint32_t mask) { return mask == ChunkMesher::ALL_SLICES; });
+    if (!everySlice) {
+      job->mesher = chunk.mesher;
+    }
+    job->mesher.meshing = chunk.mesher.meshing;
+    chunk.meshTicket = job->ticket;
+    jobs.submit([this, job] {
+      job->firstChanged = job->mesher.remesh(job->slices, job->snapshot.decode());
+      std::lock_guard<std::mutex> lock{finishedMutex};
+      meshed.push_back(job);
+    });
+}
 
-    glm::vec2 chunkXZ = {position.x, position.z};
+void World::requestBorderMeshes(const Chunk& chunk){
+    for (int face = 0; face < 6; face++) {
+      Chunk* neighbour = findChunk(chunk.position + voxel_normals[face]);
+      // a neighbour with a job in flight gets the chunk through its snapshot check
+      if (neighbour != nullptr && neighbour->meshTicket == 0 && neighbour->generateTicket == 0) {
+        // marked first, so the borders of several new chunks around it go into one job
+        neighbour->markBorderDirty(oppositeFace(face));
+        bordered.push_back(neighbour);
+      }
+    }
+}
 
-    for (int z = 0; z < CHUNK_SIZE; z++) {
-        for (int x = 0; x < CHUNK_SIZE; x++) {
-            float bx = static_cast<float>(x + position.x * CHUNK_SIZE);
-            float bz = static_cast<float>(z + position.z * CHUNK_SIZE);
+void World::replayEdits(const glm::ivec3& chunk_pos){
+    // in the order they were made, so a later edit to the same voxel still wins
+    size_t kept = 0;
+    for (size_t i = 0; i < pendingEdits.size(); i++) {
+      PendingEdit edit = pendingEdits[i];
+      if (chunkOf(edit.position) == chunk_pos) {
+        setVoxel(edit.position, edit.voxel);
+      } else {
+        pendingEdits[kept++] = edit;
+      }
+    }
+    pendingEdits.resize(kept);
+}
 
-            glm::vec2 coord =
-                (glm::vec2{bx, bz} - world_size / 2.0f) / world_size * 2.0f;
+bool World::hasFinishedJobs() const {
+    std::lock_guard<std::mutex> lock{finishedMutex};
+    return !generated.empty() || !meshed.empty() || !saved.empty() || !readyGenerated.empty() ||
+           !readyMeshed.empty() || !readySaved.empty();
+}
 
-            auto noise = getNoiseAt({x, z}, chunkXZ, firstNoise, seed);
-            auto noise2 =
-                getNoiseAt({x, z}, {position.x, position.z}, secondNoise, seed);
-            auto island = rounded(coord) * 1.25;
-            float result = noise * noise2;
-            height_map[z * CHUNK_SIZE + x] =
-                static_cast<int>((result * firstNoise.amplitude + firstNoise.offset) *
-                                  island) - 5;                        
+void World::collectJobs(int limit){
+    {
+      std::lock_guard<std::mutex> lock{finishedMutex};
+      readyGenerated.insert(readyGenerated.end(), generated.begin(), generated.end());
+      readyMeshed.insert(readyMeshed.end(), meshed.begin(), meshed.end());
+      readySaved.insert(readySaved.end(), saved.begin(), saved.end());
+      generated.clear();
+      meshed.clear();
+      saved.clear();
+    }
+    std::sort(readyGenerated.begin(), readyGenerated.end(),
+              [](const GeneratedChunk* a, const GeneratedChunk* b) { return a->ticket < b->ticket; });
+    std::sort(readyMeshed.begin(), readyMeshed.end(),
+              [](const MeshedChunk* a, const MeshedChunk* b) { return a->ticket < b->ticket; });
+    std::sort(readySaved.begin(), readySaved.end(),
+              [](const SavedChunk* a, const SavedChunk* b) { return a->ticket < b->ticket; });
+
+    // One ticket after the other, stopping at the first one still out. Only results that upload
+    // count against limit, dropped ones and staged saves cost next to nothing.
+    installed.clear();
+    size_t meshesDone = 0;
+    size_t generatedDone = 0;
+    size_t savesDone = 0;
+    while (limit > 0) {
+      uint64_t next = appliedTicket + 1;
+      if (meshesDone < readyMeshed.size() && readyMeshed[meshesDone]->ticket == next) {
+        MeshedChunk* result = readyMeshed[meshesDone++];
+        Chunk* chunk = findChunk(result->position);
+        // otherwise unloaded, meshed again or meshed synchronously since
+        if (chunk != nullptr && chunk->meshTicket == result->ticket) {
+          if (chunk->matches(result->snapshot, getNeighbours(chunk->position))) {
+            chunk->applyMesh(result->mesher, result->slices, result->firstChanged);
+            chunk->meshTicket = 0;
+            limit--;
+          } else {
+            // edited, or a neighbour came or went, while the job ran
+            ChunkMesher::SliceMasks slices;
+            slices.fill(ChunkMesher::ALL_SLICES);
+            requestMesh(*chunk, slices);
+          }
+        }
+        // the snapshot would otherwise keep the voxels it shares alive until the result is reused
+        result->snapshot = ChunkSnapshot{};
+        result->mesher.clear();
+        spareMeshed.push_back(result);
+      } else if (generatedDone < readyGenerated.size() && readyGenerated[generatedDone]->ticket == next) {
+        GeneratedChunk* result = readyGenerated[generatedDone++];
+        Chunk* chunk = findChunk(result->position);
+        // otherwise unloaded, or unloaded and requested again, since
+        if (chunk != nullptr && chunk->generateTicket == result->ticket) {
+          chunk->generateTicket = 0;
+          // swapped, so the result keeps the chunk's old storage for the next job to fill
+          std::swap(chunk->editVoxels(), result->voxels);
+          chunk->unsaved = !result->loaded;
+          if (voxelTree) {
+            voxelTree->writeChunk(chunk->position, chunk->voxels());
+          }
+          replayEdits(chunk->position);
+          installed.push_back(chunk);
+          limit--;
+        }
+        result->source.reset();
+        spareGenerated.push_back(result);
+      } else if (savesDone < readySaved.size() && readySaved[savesDone]->ticket == next) {
+        SavedChunk* result = readySaved[savesDone++];
+        result->region->writeCompressed(result->position, result->compressed);
+        // a later save of the chunk still in flight keeps its own voxels there
+        auto staged = saving.find({result->position.x, result->position.y, result->position.z});
+        if (staged != saving.end() && staged->second == result->voxels) {
+          saving.erase(staged);
         }
+        result->voxels.reset();
+        spareSaved.push_back(result);
+      } else {
+        break;
+      }
+      appliedTicket = next;
+    }
+    readyMeshed.erase(readyMeshed.begin(), readyMeshed.begin() + meshesDone);
+    readyGenerated.erase(readyGenerated.begin(), readyGenerated.begin() + generatedDone);
+    readySaved.erase(readySaved.begin(), readySaved.begin() + savesDone);
+
+    // every chunk is in before any is meshed, so no snapshot misses a neighbour installed with it
+    bordered.clear();
+    for (Chunk* chunk : installed) {
+      if (chunk->mesher.meshing == MeshingStrategy::gpu) {
+        // meshes the neighbours along with it
+        meshChunk(*chunk);
+      } else {
+        ChunkMesher::SliceMasks slices;
+        slices.fill(ChunkMesher::ALL_SLICES);
+        requestMesh(*chunk, slices);
+      }
+    }
+    for (Chunk* chunk : installed) {
+      if (chunk->mesher.meshing != MeshingStrategy::gpu) {
+        requestBorderMeshes(*chunk);
+      }
+    }
+    for (Chunk* neighbour : bordered) {
+      // a neighbour of several installed chunks is in the list once for each
+      if (neighbour->meshTicket == 0) {
+        requestMesh(*neighbour, neighbour->dirtyLayers());
+      }
     }
 }
 
-float generateSeed(const std::string& input){
-    std::hash<std::string> strhash;
+Chunk& World::acquireChunk(const glm::ivec3& chunk_pos){
+    Chunk* chunk = chunks.find(chunk_pos);
+    if (chunk != nullptr) {
+      return *chunk;
+    }
+    Chunk& acquired = chunks.insert(chunkPool.acquire(chunk_pos));
+    acquired.mesher.meshing = meshingStrategy;
+    return acquired;
+}
 
-    float seed_float;
-    uint32_t hash = strhash(input);
-    std::memcpy(&seed_float, &hash, sizeof(float));
-    return seed_float;
+void World::unloadChunk(const glm::ivec3& chunk_pos){
+    std::unique_ptr<ZxGameObject> chunk_obj = chunks.erase(chunk_pos);
+    if (!chunk_obj) {
+      return;
+    }
+    // Compressed by a job and then staged in its region, so coming back is a decompress even
+    // before the next saveChunks. The job shares the voxels, the pool gives the chunk new ones.
+    Chunk& chunk = *chunk_obj->chunk;
+    if (chunk.unsaved) {
+      requestSave(chunk_pos, chunk.shareVoxels());
+      chunk.unsaved = false;
+    }
+    // the tree only holds what is loaded, what is not comes back from the region file
+    if (voxelTree) {
+      glm::ivec3 chunkMin = chunk_pos * CHUNK_SIZE;
+      voxelTree->fill(chunkMin, chunkMin + CHUNK_SIZE, air);
+    }
+    // the border faces of the neighbours facing it stay as they are, they lie beyond the view
+    // distance and are rebuilt by meshChunk once the chunk comes back
+    chunkPool.release(std::move(chunk_obj));
 }
 
-void World::createTerrain(const glm::vec2& chunk_pos){
-  for (int z = 0; z < CHUNK_SIZE; z++) {
-    for (int x = 0; x < CHUNK_SIZE; x++) {
-        int height = height_map[z * CHUNK_SIZE + x];
-        for (int y = 0; y < CHUNK_SIZE; y++) {
-            int voxel_y = chunk_pos.y * CHUNK_SIZE + y;
-            Voxel voxel = air;
-
-            if(voxel_y <= height){
-              if(voxel_y > WATER_LEVEL){
-                voxel = stone;
-              }
-              else if(voxel_y == WATER_LEVEL){
-                voxel = grass;
-              }
-              else{
-                voxel = stone;
-              }
-            }
-            chunks[chunk_pos.x + chunk_pos.y * CHUNK_SIZE]->chunk->voxels.push_back(voxel);
+void World::updateStreaming(const glm::vec3& camera_position){
+    glm::ivec2 center{floorDiv(static_cast<int>(std::floor(camera_position.x)), CHUNK_SIZE),
+                      floorDiv(static_cast<int>(std::floor(camera_position.z)), CHUNK_SIZE)};
+    if (loadOrderDistance != viewDistance) {
+      loadOrder.clear();
+      for (int z = -viewDistance; z <= viewDistance; z++) {
+        for (int x = -viewDistance; x <= viewDistance; x++) {
+          if (x * x + z * z <= viewDistance * viewDistance) {
+            loadOrder.push_back({x, z});
+          }
         }
+      }
+      // ties keep the row order above, so the order never depends on the sort implementation
+      std::stable_sort(loadOrder.begin(), loadOrder.end(), [](const glm::ivec2& a, const glm::ivec2& b) {
+        return a.x * a.x + a.y * a.y < b.x * b.x + b.y * b.y;
+      });
+      loadOrderDistance = viewDistance;
+      streamingStarted = false;
+      reserveChunks();
+    }
+    if (!streamingStarted || center != streamingCenter) {
+      streamingCenter = center;
+      streamingStarted = true;
+      loadCursor = 0;
+      unloadCursor = 0;
+      loadQueue.clear();
+      unloadQueue.clear();
+    }
+
+    int checks = streamingChecksPerFrame;
+    while (checks > 0 && loadCursor < loadOrder.size() &&
+           loadQueue.size() < static_cast<size_t>(columnLoadsPerFrame)) {
+      glm::ivec2 column = center + loadOrder[loadCursor++];
+      if (!columnLoaded(column)) {
+        loadQueue.push_back(column);
+      }
+      checks--;
+    }
+
+    int unload_distance = viewDistance + unloadMargin;
+    // chunks loaded during the sweep are appended and checked too, they are near the camera
+    while (checks > 0 && unloadCursor < chunks.storedCount() &&
+           unloadQueue.size() < static_cast<size_t>(chunkUnloadsPerFrame)) {
+      const ZxGameObject* chunk_obj = chunks.stored(unloadCursor++);
+      if (chunk_obj == nullptr) {
+        continue;
+      }
+      const glm::ivec3& chunk_pos = chunk_obj->chunk->position;
+      glm::ivec2 offset = glm::ivec2{chunk_pos.x, chunk_pos.z} - center;
+      if (offset.x * offset.x + offset.y * offset.y > unload_distance * unload_distance) {
+        unloadQueue.push_back(chunk_pos);
+      }
+      checks--;
     }
-  }
-  chunks[chunk_pos.x + chunk_pos.y * CHUNK_SIZE]->chunk->create_mesh(chunk_pos);
 }
 
-void World::generateTerrain(glm::vec2& chunk_pos, uint32_t worldSize){
-    glm::vec3 position{chunk_pos.x, 0, chunk_pos.y}; // y is actually z LOL
-    createChunkHeightMap(position, worldSize, generateSeed("my seed"));
+bool World::hasPendingStreaming() const {
+    return !loadQueue.empty() || !unloadQueue.empty() || hasFinishedJobs();
+}
+
+void World::flushStreaming(){
+    // unloading first gives the pool chunks back before the loads take them
+    for (const glm::ivec3& chunk_pos : unloadQueue) {
+      unloadChunk(chunk_pos);
+    }
+    if (!unloadQueue.empty()) {
+      // the chunks keep their order, so the sweep goes on where it was
+      chunks.compact(unloadCursor);
+      unloadQueue.clear();
+    }
+    collectJobs(jobResultsPerFrame);
+    for (glm::ivec2 column : loadQueue) {
+      loadColumn(column);
+    }
+    loadQueue.clear();
+}
+
+void World::reserveChunks(){
+    size_t side = static_cast<size_t>(2 * (viewDistance + unloadMargin) + 1);
+    size_t count = side * side * COLUMN_HEIGHT;
+    // the loaded ones are out of the pool already
+    chunkPool.reserve(count - std::min(count, chunks.size()));
+    chunks.reserve(count);
+}
+
+RegionFile& World::region(const glm::ivec3& chunk_pos){
+    glm::ivec2 region_pos = RegionFile::regionOf(chunk_pos);
+    std::unique_ptr<RegionFile>& region = regions[{region_pos.x, region_pos.y}];
+    if (!region) {
+      region = std::make_unique<RegionFile>(saveDirectory + "/r." + std::to_string(region_pos.x) + "." +
+                                            std::to_string(region_pos.y) + ".zxr");
+    }
+    return *region;
+}
+
+void World::saveChunks(){
+    // the chunks still loading go in first, so what they generate is saved as well
+    jobs.wait();
+    collectJobs(std::numeric_limits<int>::max());
+    // regions keep chunks by position, so the order they are written in here does not matter
+    for (auto& chunk_obj : chunks) {
+      Chunk& chunk = *chunk_obj->chunk;
+      if (chunk.unsaved) {
+        requestSave(chunk.position, chunk.shareVoxels());
+        chunk.unsaved = false;
+      }
+    }
+    // every save is staged once its job is collected, the ones of unloaded chunks as well
+    jobs.wait();
+    collectJobs(std::numeric_limits<int>::max());
+    zxDevice.flushUploads();
+    for (auto& region : regions) {
+      region.second->flush();
+    }
+}
+
+void World::setMeshingStrategy(MeshingStrategy strategy){
+    meshingStrategy = strategy;
+    std::vector<Chunk*> all;
+    for (auto& chunk_obj : chunks) {
+      chunk_obj->chunk->mesher.meshing = strategy;
+      all.push_back(chunk_obj->chunk.get());
+    }
+    meshChunks(all);
+    // every chunk is uploaded at once, more staging than a frame should hold on to
+    zxDevice.flushUploads();
+
+    uint32_t faces = 0;
+    size_t voxelBytes = 0;
+    for (Chunk* chunk : all) {
+      faces += chunk->faceCount;
+      voxelBytes += chunk->voxels().memoryUsage();
+    }
+    if (voxelTree) {
+      voxelBytes += voxelTree->memoryUsage();
+    }
+    std::cout << "Meshing " << meshingStrategyName(strategy) << ": "
+              << faces << " faces, " << faces * sizeof(Chunk::Face) << " bytes, "
+              << voxelBytes << " bytes of voxels" << std::endl;
+}
+
+Chunk* World::findChunk(const glm::ivec3& chunk_pos){
+    return chunks.find(chunk_pos);
+}
+
+ChunkNeighbours World::getNeighbours(const glm::ivec3& chunk_pos){
+    return chunks.neighbours(chunk_pos);
+}
+
+ChunkVoxels World::decodeVoxels(const Chunk& chunk){
+    return chunk.decodeVoxels(getNeighbours(chunk.position));
+}
+
+void World::meshChunk(Chunk& chunk){
+    if (chunk.mesher.meshing == MeshingStrategy::gpu) {
+      // the border faces of the neighbours are cheap to redo along with the chunk in the same pass
+      std::vector<Chunk*> batch{&chunk};
+      for (int face = 0; face < 6; face++) {
+        Chunk* neighbour = findChunk(chunk.position + voxel_normals[face]);
+        if (neighbour != nullptr) {
+          batch.push_back(neighbour);
+        }
+      }
+      meshChunks(batch);
+      return;
+    }
+    ChunkMesher::SliceMasks slices;
+    slices.fill(ChunkMesher::ALL_SLICES);
+    requestMesh(chunk, slices);
+    bordered.clear();
+    requestBorderMeshes(chunk);
+    for (Chunk* neighbour : bordered) {
+      requestMesh(*neighbour, neighbour->dirtyLayers());
+    }
+}
+
+void World::meshChunks(const std::vector<Chunk*>& batch){
+    std::vector<Chunk*> gpuChunks;
+    std::vector<ChunkNeighbours> gpuNeighbours;
+    for (Chunk* chunk : batch) {
+      // whatever a mesh job still hands back is older than this
+      chunk->meshTicket = 0;
+      // uniform chunks only have border faces, cheaper on the CPU than a dispatch
+      if (chunk->mesher.meshing == MeshingStrategy::gpu && !chunk->voxels().isUniform()) {
+        gpuChunks.push_back(chunk);
+        gpuNeighbours.push_back(getNeighbours(chunk->position));
+      } else {
+        chunk->create_mesh(decodeVoxels(*chunk));
+      }
+    }
+    if (gpuChunks.empty()) {
+      return;
+    }
+    if (!computeSystem) {
+      computeSystem = std::make_unique<ChunkComputeSystem>(zxDevice);
+    }
+    computeSystem->meshChunks(gpuChunks, gpuNeighbours);
+}
+
+void World::setVoxel(const glm::ivec3& voxel_pos, Voxel voxel){
+    glm::ivec3 chunk_pos = chunkOf(voxel_pos);
+    Chunk* chunk = findChunk(chunk_pos);
+    // what is not loaded comes back from its region file or the terrain as it was
+    if (chunk == nullptr) {
+      return;
+    }
+    if (chunk->generateTicket != 0) {
+      // the loaded voxels would overwrite it, collectJobs replays it once they are in
+      pendingEdits.push_back({voxel_pos, voxel});
+      return;
+    }
+    glm::ivec3 local = voxel_pos - chunk_pos * CHUNK_SIZE;
+    chunk->setVoxel(local.x, local.y, local.z, voxel);
+    queueEdited(*chunk);
+    if (voxelTree) {
+      voxelTree->set(voxel_pos, voxel);
+    }
+
+    // on a border the neighbour's outer layer looks at this voxel too
+    for (int face = 0; face < 6; face++) {
+      glm::ivec3 next = local + voxel_normals[face];
+      bool outside = next.x < 0 || next.x >= CHUNK_SIZE || next.y < 0 || next.y >= CHUNK_SIZE ||
+                     next.z < 0 || next.z >= CHUNK_SIZE;
+      if (!outside) {
+        continue;
+      }
+      Chunk* neighbour = findChunk(chunk_pos + voxel_normals[face]);
+      if (neighbour != nullptr) {
+        neighbour->markBorderDirty(oppositeFace(face));
+        queueEdited(*neighbour);
+      }
+    }
+}
+
+void World::queueEdited(Chunk& chunk){
+    if (!chunk.editQueued) {
+      chunk.editQueued = true;
+      editedChunks.push_back(chunk.position);
+    }
+}
+
+Voxel World::getVoxel(const glm::ivec3& voxel_pos) const {
+    glm::ivec3 chunk_pos = chunkOf(voxel_pos);
+    const Chunk* chunk = chunks.find(chunk_pos);
+    if (chunk == nullptr) {
+      return air;
+    }
+    glm::ivec3 local = voxel_pos - chunk_pos * CHUNK_SIZE;
+    return chunk->getVoxel(local.x, local.y, local.z);
+}
+
+void World::enableVoxelTree(){
+    if (voxelTree) {
+      return;
+    }
+    voxelTree = std::make_unique<VoxelTree>(5);
+    for (auto& chunk_obj : chunks) {
+      const Chunk& chunk = *chunk_obj->chunk;
+      // still air until its loaded voxels are installed, which writes them in
+      if (chunk.generateTicket == 0) {
+        voxelTree->writeChunk(chunk.position, chunk.voxels());
+      }
+    }
+}
+
+bool World::hasPendingEdits(){
+    for (const glm::ivec3& chunk_pos : editedChunks) {
+      Chunk* chunk = findChunk(chunk_pos);
+      // a mesh job in flight covers the chunk's dirty layers, or fails its snapshot check
+      if (chunk != nullptr && chunk->isDirty() && chunk->meshTicket == 0) {
+        return true;
+      }
+    }
+    return false;
+}
 
-    std::cout << "Creating terrain..." << std::endl;
-    for (int y = 0; y < 1; y++) {
-      createTerrain(chunk_pos);
+void World::flushEdits(){
+    size_t kept = 0;
+    for (size_t i = 0; i < editedChunks.size(); i++) {
+      glm::ivec3 chunk_pos = editedChunks[i];
+      Chunk* chunk = findChunk(chunk_pos);
+      // unloaded since, or a chunk acquired there afterwards that queues itself when edited
+      if (chunk == nullptr || !chunk->editQueued) {
+        continue;
+      }
+      // what is edited after the job's snapshot is left dirty once its result is in
+      if (chunk->meshTicket != 0) {
+        editedChunks[kept++] = chunk_pos;
+        continue;
+      }
+      chunk->editQueued = false;
+      chunk->remeshDirty(decodeVoxels(*chunk));
     }
+    editedChunks.resize(kept);
 }
 }
\ No newline at end of file
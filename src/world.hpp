@@ -1,42 +1,252 @@
 #pragma once
 
 #include "chunk.hpp"
+#include "chunk_map.hpp"
+#include "chunk_pool.hpp"
 #include "defines.hpp"
+#include "job_system.hpp"
+#include "region_file.hpp"
+#include "terrain_generator.hpp"
+#include "voxel_tree.hpp"
 #include "zx_device.hpp"
 #include "zx_game_object.hpp"
+#include "systems/chunk_compute_system.hpp"
 
 #include <glm/glm.hpp>
-#include <glm/gtc/noise.hpp>
 
 #include <vector>
+#include <map>
 #include <memory> // for std::shared_ptr<>
 #include <array>
 #include <functional> // for std::max()
 #include <cstring> // for std::memcpy()
+#include <string>
+#include <utility>
+#include <cstdint>
+#include <mutex>
+#include <tuple>
 
 namespace zx {
 
-struct NoiseSettings {
-  int octaves;
-  float amplitude;
-  float smoothness;
-  float roughness;
-  float offset;
-};
-
 class World {
 public:
-  World(ZxDevice& zxDevice);
+  // generation and mesh jobs run on workerCount threads, the world comes out the same for any
+  World(ZxDevice& zxDevice, unsigned workerCount = JobSystem::defaultWorkerCount());
 
   ~World();
 
-  void createChunkHeightMap(const glm::vec3& position, int worldSize, int seed);
-  void createTerrain(const glm::vec2& chunk_pos);
-  void generateTerrain(glm::vec2& chunk_pos, uint32_t worldSize);
+  // chunks per column, from chunk y 0 up to the highest terrain, so the chunks above it are
+  // all air and the ones under the lowest terrain of their column all stone
+  static constexpr int COLUMN_HEIGHT = TERRAIN_MAX_HEIGHT / CHUNK_SIZE + 1;
+
+  // Loads or generates every column within radius of center (x and z) on all of jobs' workers
+  // and meshes them, returning once they are all done. For filling the world before the first
+  // frame, streaming then only has to keep up with the camera.
+  void pregenerate(const glm::ivec2& center, int radius);
+
+  // the chunk at chunk_pos, taken from the pool and added when it is not loaded yet
+  Chunk& acquireChunk(const glm::ivec3& chunk_pos);
+
+  // Writes every chunk generated or edited since it was last saved and flushes the regions,
+  // waiting for the jobs in flight, the saves of unloaded chunks among them. Waits for the
+  // uploads as well, so not while a frame is being recorded.
+  void saveChunks();
+
+  Chunk* findChunk(const glm::ivec3& chunk_pos);
+  ChunkNeighbours getNeighbours(const glm::ivec3& chunk_pos);
+  // Meshes a filled chunk, then rebuilds the border faces of every loaded neighbour facing it.
+  // Chunks meshed on the CPU are meshed by jobs, neighbours included, and show up once
+  // flushStreaming collects them.
+  void meshChunk(Chunk& chunk);
+  // meshes many chunks at once, the ones set to MeshingStrategy::gpu in a single compute pass
+  void meshChunks(const std::vector<Chunk*>& chunks);
+
+  // In world voxel coordinates. Edits are batched, they show up once flushEdits remeshes
+  // the touched layers, which should happen once per frame before the frame is recorded.
+  // An edit to a chunk still being loaded waits until the loaded voxels are in.
+  void setVoxel(const glm::ivec3& voxel_pos, Voxel voxel);
+  // air outside the loaded chunks
+  Voxel getVoxel(const glm::ivec3& voxel_pos) const;
+  // Builds voxelTree from the loaded chunks and keeps it up to date from then on. On from the
+  // start when built with ZENIX_VOXEL_TREE.
+  void enableVoxelTree();
+  bool hasPendingEdits();
+  void flushEdits();
+  // remeshes every chunk and waits for the uploads
+  void setMeshingStrategy(MeshingStrategy strategy);
+
+  // Streaming keeps the chunk columns within viewDistance of the camera loaded, nearest first, and
+  // unloads the ones beyond viewDistance + unloadMargin, so moving back and forth over a column
+  // border does not reload anything. updateStreaming is cheap and runs every frame: it checks at
+  // most streamingChecksPerFrame columns and chunks and queues what has to change. flushStreaming
+  // then loads and unloads the queued ones. Like flushEdits it only queues uploads and retires
+  // buffers, the frames in flight keep drawing the old ones. Both stop at their per frame limits,
+  // so a frame costs the same at any view distance and a large one just takes more frames to fill
+  // in. Loading, generation, compressing saves and meshing run as jobs, flushStreaming also hands
+  // their results over.
+  void updateStreaming(const glm::vec3& camera_position);
+  bool hasPendingStreaming() const;
+  void flushStreaming();
+
+  // In chunk columns. Every chunk within the unload ring holds one of the face descriptor sets
+  // of VoxelRenderSystem, which adds descriptor pools as the ring grows.
+  int viewDistance = 8;
+  int unloadMargin = 2;
+  int columnLoadsPerFrame = 2;
+  int chunkUnloadsPerFrame = 8;
+  // finished load and mesh jobs applied by a flushStreaming, each costs an upload
+  int jobResultsPerFrame = 16;
+  int streamingChecksPerFrame = 256;
 
-  std::vector<std::unique_ptr<ZxGameObject>> chunks;
-  std::array<uint32_t, CHUNK_AREA> height_map;
+  // Every loaded chunk by chunk position, iterated in the order they were loaded. Tombstones
+  // left by unloads are compacted away by flushStreaming.
+  ChunkMap chunks;
+  // The voxels of every loaded chunk again, in world voxels, for queries over regions larger
+  // than a chunk. The chunks stay what is meshed and saved, the tree is derived from them:
+  // generated and loaded chunks are written in, edits set and unloaded chunks cleared back to
+  // air. A root covers 1024 voxels per side, the chunks of one region file. nullptr until
+  // enableVoxelTree, keeping it costs a chunk write on every install.
+  std::unique_ptr<VoxelTree> voxelTree;
 
   ZxDevice& zxDevice;
+
+  // terrain of chunks that were never saved, without the island falloff so streaming never
+  // runs out of it
+  TerrainGenerator terrain;
+
+  // one region file per 32 by 32 chunk columns goes here
+  std::string saveDirectory = "saves/world";
+
+private:
+  RegionFile& region(const glm::ivec3& chunk_pos);
+  // Chunk objects and map slots for every chunk the unload ring can hold, so streaming a full
+  // ring in allocates neither. Again whenever viewDistance changes.
+  void reserveChunks();
+  // saves the chunk if it changed and hands it back to the pool
+  void unloadChunk(const glm::ivec3& chunk_pos);
+  // whether every chunk of the column is loaded
+  bool columnLoaded(const glm::ivec2& column) const;
+  // the chunks of the column that are not loaded, by load jobs
+  void loadColumn(const glm::ivec2& column);
+  // what the mesher reads for chunk, valid until the next call
+  ChunkVoxels decodeVoxels(const Chunk& chunk);
+
+  void queueEdited(Chunk& chunk);
+
+  // What a job hands back. Every job gets the next ticket when it is submitted and collectJobs
+  // applies results in ticket order, holding back the ones that finish before a job submitted
+  // earlier. Voxels and the edits waiting for them then land in the same order however many workers
+  // run the jobs and whichever finishes first, and since a mesh only depends on the voxels it was
+  // made from, so do the faces they end up with. Stale results are recognised by their ticket and
+  // snapshot, not by when they arrive. Results are pooled like chunks: a job only captures World
+  // and its result, which fits inside std::function without a heap block, and the voxels and faces
+  // of a reused result keep their storage. What still allocates once warm: the job deques take and
+  // give back a block every few dozen jobs, an edit copies the voxels of a chunk while a mesh job's
+  // snapshot holds them, and voxelTree, when kept, grows its node pools and roots as terrain it has
+  // not held before streams in.
+  struct GeneratedChunk {
+    uint64_t ticket;
+    glm::ivec3 position;
+    // the voxels a save still in flight holds, else nullptr and the chunk is read from region
+    std::shared_ptr<const PalettedVoxels> source;
+    RegionFile* region;
+    PalettedVoxels voxels;
+    // false when the chunk was never saved and got generated
+    bool loaded;
+  };
+  struct SavedChunk {
+    uint64_t ticket;
+    glm::ivec3 position;
+    std::shared_ptr<const PalettedVoxels> voxels;
+    RegionFile* region;
+    RegionFile::CompressedChunk compressed;
+  };
+  struct MeshedChunk {
+    uint64_t ticket;
+    glm::ivec3 position;
+    ChunkSnapshot snapshot;
+    ChunkMesher::SliceMasks slices;
+    ChunkMesher mesher;
+    uint32_t firstChanged;
+  };
+  // Fills the chunk on a worker: copied from a save still in flight, read from its region file
+  // or else generated.
+  void requestLoad(Chunk& chunk);
+  // compresses voxels on a worker, collectJobs stages them in the region of chunk_pos
+  void requestSave(const glm::ivec3& chunk_pos, std::shared_ptr<const PalettedVoxels> voxels);
+  // Meshes slices of the chunk on a worker. Every slice starts from a cleared mesher, fewer from
+  // a copy of the chunk's, which then only has to upload what changed.
+  void requestMesh(Chunk& chunk, const ChunkMesher::SliceMasks& slices);
+  // meshes the border layers of the loaded neighbours of chunk facing it, as jobs
+  void requestBorderMeshes(const Chunk& chunk);
+  // applies the edits that waited for the chunk at chunk_pos to be loaded
+  void replayEdits(const glm::ivec3& chunk_pos);
+  // finished results, collected or not
+  bool hasFinishedJobs() const;
+  // Installs loaded voxels, stages saves and uploads meshes, meshing again the ones edited
+  // meanwhile. At most limit results are applied, in ticket order up to the first ticket whose
+  // job has not finished, the rest wait for the next call. The chunks installed are meshed once
+  // all of them are in, so no snapshot misses a neighbour installed with it.
+  void collectJobs(int limit);
+
+  // every chunk object comes from here and goes back here
+  ChunkPool chunkPool;
+  // created the first time a chunk is meshed on the GPU
+  std::unique_ptr<ChunkComputeSystem> computeSystem;
+  // picked up by chunks as they are streamed in
+  MeshingStrategy meshingStrategy = MeshingStrategy::binary;
+
+  // the camera's chunk column (x and z), streaming starts over from it whenever it changes
+  glm::ivec2 streamingCenter{0};
+  bool streamingStarted = false;
+  // column offsets within loadOrderDistance, nearest first
+  std::vector<glm::ivec2> loadOrder;
+  int loadOrderDistance = -1;
+  // the next offset of loadOrder and the next stored chunk to check for unloading
+  size_t loadCursor = 0;
+  size_t unloadCursor = 0;
+  std::vector<glm::ivec2> loadQueue;
+  std::vector<glm::ivec3> unloadQueue;
+
+  // opened the first time a chunk in them is loaded or saved, by region x and z
+  std::map<std::pair<int, int>, std::unique_ptr<RegionFile>> regions;
+
+  uint64_t nextTicket = 0;
+  // every ticket up to this one has been applied or dropped
+  uint64_t appliedTicket = 0;
+  // every result ever made, and the ones no job holds right now
+  std::vector<std::unique_ptr<GeneratedChunk>> generatedResults;
+  std::vector<std::unique_ptr<MeshedChunk>> meshedResults;
+  std::vector<std::unique_ptr<SavedChunk>> savedResults;
+  std::vector<GeneratedChunk*> spareGenerated;
+  std::vector<MeshedChunk*> spareMeshed;
+  std::vector<SavedChunk*> spareSaved;
+  // filled by the jobs, emptied by collectJobs
+  mutable std::mutex finishedMutex;
+  std::vector<GeneratedChunk*> generated;
+  std::vector<MeshedChunk*> meshed;
+  std::vector<SavedChunk*> saved;
+  // Collected but not applied yet, sorted by ticket. Only touched by the thread calling
+  // collectJobs, like the vectors below, which are kept so their capacity is too.
+  std::vector<GeneratedChunk*> readyGenerated;
+  std::vector<MeshedChunk*> readyMeshed;
+  std::vector<SavedChunk*> readySaved;
+  std::vector<Chunk*> installed;
+  std::vector<Chunk*> bordered;
+  // Edits to chunks with a load job in flight, in the order they were made. Kept by position,
+  // so the edits to a chunk unloaded meanwhile land when it is loaded again.
+  struct PendingEdit {
+    glm::ivec3 position;
+    Voxel voxel;
+  };
+  std::vector<PendingEdit> pendingEdits;
+  // Chunks setVoxel left dirty, by position so an unload does not leave a dangling entry. What
+  // hasPendingEdits and flushEdits look at instead of every loaded chunk.
+  std::vector<glm::ivec3> editedChunks;
+  // The voxels of unloaded chunks whose save job has not been staged yet, by chunk position. A
+  // chunk loaded again meanwhile copies them, its region file does not hold them yet.
+  std::map<std::tuple<int, int, int>, std::shared_ptr<const PalettedVoxels>> saving;
+  // last, so its workers are joined before anything a job touches goes away
+  JobSystem jobs;
 };
 }
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include "zx_device.hpp"
+#include "zx_buffer.hpp"
 #include "zx_utils.hpp"
 
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <unordered_set>
 
@@ -57,6 +59,13 @@ ZxDevice::ZxDevice(ZxWindow &window) : window{window} {
 }
 
 ZxDevice::~ZxDevice() {
+  // the owner waited for the device to go idle, nothing retired is in use anymore
+  if (uploadCommandBuffer != VK_NULL_HANDLE) {
+    vkFreeCommandBuffers(device_, commandPool, 1, &uploadCommandBuffer);
+  }
+  uploadStagingBuffers.clear();
+  releaseRetiredBefore(std::numeric_limits<uint64_t>::max());
+
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -484,18 +493,131 @@ void ZxDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
-void ZxDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+void ZxDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset) {
   VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
   VkBufferCopy copyRegion{};
   copyRegion.srcOffset = 0;  // Optional
-  copyRegion.dstOffset = 0;  // Optional
+  copyRegion.dstOffset = dstOffset;
   copyRegion.size = size;
   vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
   endSingleTimeCommands(commandBuffer);
 }
 
+void ZxDevice::uploadBuffer(
+    std::unique_ptr<ZxBuffer> stagingBuffer,
+    VkBuffer dstBuffer,
+    VkDeviceSize size,
+    VkDeviceSize dstOffset) {
+  if (uploadCommandBuffer == VK_NULL_HANDLE) {
+    uploadCommandBuffer = beginSingleTimeCommands();
+  }
+  // Earlier frames may still read what the copy overwrites and an earlier copy of this batch
+  // may write the same range. The barrier covers everything submitted before it on the queue.
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(
+      uploadCommandBuffer,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      1,
+      &barrier,
+      0,
+      nullptr,
+      0,
+      nullptr);
+
+  VkBufferCopy copyRegion{};
+  copyRegion.srcOffset = 0;
+  copyRegion.dstOffset = dstOffset;
+  copyRegion.size = size;
+  vkCmdCopyBuffer(uploadCommandBuffer, stagingBuffer->getBuffer(), dstBuffer, 1, &copyRegion);
+  uploadStagingBuffers.push_back(std::move(stagingBuffer));
+}
+
+void ZxDevice::submitUploads() {
+  if (uploadCommandBuffer == VK_NULL_HANDLE) {
+    return;
+  }
+  // the uploaded buffers are read as faces, indices and indirect commands by later frames
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                          VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkCmdPipelineBarrier(
+      uploadCommandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      0,
+      1,
+      &barrier,
+      0,
+      nullptr,
+      0,
+      nullptr);
+  vkEndCommandBuffer(uploadCommandBuffer);
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &uploadCommandBuffer;
+  if (vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+    panic("Failed to submit upload command buffer!");
+  }
+
+  // The fence of the next frame also covers this submission, so the staging buffers and
+  // the command buffer go with the buffers retired now.
+  retire(nullptr, uploadCommandBuffer);
+  for (auto &stagingBuffer : uploadStagingBuffers) {
+    retire(std::move(stagingBuffer), VK_NULL_HANDLE);
+  }
+  uploadStagingBuffers.clear();
+  uploadCommandBuffer = VK_NULL_HANDLE;
+}
+
+void ZxDevice::retireBuffer(std::unique_ptr<ZxBuffer> buffer) {
+  if (buffer) {
+    retire(std::move(buffer), VK_NULL_HANDLE);
+  }
+}
+
+void ZxDevice::retire(std::unique_ptr<ZxBuffer> buffer, VkCommandBuffer commandBuffer) {
+  retired.push_back(Retired{submittedFrames, std::move(buffer), commandBuffer});
+}
+
+void ZxDevice::releaseRetired(int framesInFlight) {
+  // Frames finish in the order they were submitted, so all but the last framesInFlight
+  // have. Something retired with n frames submitted waits for frame n + 1.
+  uint64_t inFlight = static_cast<uint64_t>(framesInFlight);
+  if (submittedFrames > inFlight) {
+    releaseRetiredBefore(submittedFrames - inFlight);
+  }
+}
+
+void ZxDevice::releaseRetiredBefore(uint64_t frame) {
+  // retired is in retirement order, so the released ones are a prefix
+  size_t released = 0;
+  while (released < retired.size() && retired[released].frame < frame) {
+    if (retired[released].commandBuffer != VK_NULL_HANDLE) {
+      vkFreeCommandBuffers(device_, commandPool, 1, &retired[released].commandBuffer);
+    }
+    released++;
+  }
+  retired.erase(retired.begin(), retired.begin() + released);
+}
+
+void ZxDevice::flushUploads() {
+  submitUploads();
+  vkQueueWaitIdle(graphicsQueue_);
+  releaseRetiredBefore(std::numeric_limits<uint64_t>::max());
+}
+
 void ZxDevice::copyBufferToImage(
     VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
   VkCommandBuffer commandBuffer = beginSingleTimeCommands();
@@ -3,11 +3,14 @@
 #include "defines.hpp"
 #include "zx_window.hpp"
 
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace zx {
 
+class ZxBuffer;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -62,10 +65,30 @@ class ZxDevice {
       VkDeviceMemory &bufferMemory);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset = 0);
   void copyBufferToImage(
       VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
+  // Copies out of stagingBuffer without waiting for the queue. The copies of a frame are
+  // recorded into one command buffer that submitUploads submits ahead of the frame, after
+  // the frames in flight are done reading the buffers they overwrite.
+  void uploadBuffer(
+      std::unique_ptr<ZxBuffer> stagingBuffer,
+      VkBuffer dstBuffer,
+      VkDeviceSize size,
+      VkDeviceSize dstOffset = 0);
+  // A buffer the frames in flight or the pending uploads may still use, destroyed by
+  // releaseRetired once the frame submitted after it was retired has finished.
+  void retireBuffer(std::unique_ptr<ZxBuffer> buffer);
+  // ZxRenderer calls submitUploads right before it submits a frame and frameSubmitted right
+  // after, and releaseRetired once it has waited for a frame fence with framesInFlight frames
+  // still allowed to run.
+  void submitUploads();
+  void frameSubmitted() { submittedFrames++; }
+  void releaseRetired(int framesInFlight);
+  // submits the pending uploads and waits for them, for when no frame follows soon
+  void flushUploads();
+
   void createImageWithInfo(
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
@@ -98,6 +121,20 @@ class ZxDevice {
   ZxWindow &window;
   VkCommandPool commandPool;
 
+  struct Retired {
+    // frames submitted when it was retired
+    uint64_t frame;
+    std::unique_ptr<ZxBuffer> buffer;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+  };
+  void retire(std::unique_ptr<ZxBuffer> buffer, VkCommandBuffer commandBuffer);
+  void releaseRetiredBefore(uint64_t frame);
+
+  VkCommandBuffer uploadCommandBuffer = VK_NULL_HANDLE;
+  std::vector<std::unique_ptr<ZxBuffer>> uploadStagingBuffers;
+  std::vector<Retired> retired;
+  uint64_t submittedFrames = 0;
+
   VkDevice device_;
   VkSurfaceKHR surface_;
   VkQueue graphicsQueue_;
@@ -70,10 +70,11 @@ ZxGameObject ZxGameObject::makePointLight(float intensity, float radius, glm::ve
 
 std::unique_ptr<ZxGameObject> ZxGameObject::create_chunk_object(ZxDevice& zxDevice, glm::vec3 position){
   ZxGameObject gameObj = ZxGameObject::createGameObject();
-  gameObj.transform.translation = position;
+  gameObj.transform.translation = position * static_cast<float>(CHUNK_SIZE);
   gameObj.transform.scale = {1.f, 1.f, 1.f};
   gameObj.chunk = std::make_unique<Chunk>(zxDevice);
-  return std::make_unique<ZxGameObject>(gameObj);
+  gameObj.chunk->position = glm::ivec3{position};
+  return std::make_unique<ZxGameObject>(std::move(gameObj));
 }
 
 }
\ No newline at end of file
@@ -42,6 +42,7 @@ class ZxGameObject {
   static ZxGameObject makePointLight(
       float intensity = 10.f, float radius = 0.1f, glm::vec3 color = glm::vec3(1.f));
       
+  // position is in chunks, see Chunk::position
   static std::unique_ptr<ZxGameObject> create_chunk_object(ZxDevice& zxDevice, glm::vec3 position);
 
   ZxGameObject(const ZxGameObject &) = delete;
@@ -47,6 +47,8 @@ class ZxPipeline {
   static void enableAlphaBlending(PipelineConfigInfo& configInfo);
 
  private:
+  friend class ZxComputePipeline;
+
   static std::vector<char> readFile(const std::string& filepath);
 
   void createGraphicsPipeline(
@@ -61,4 +63,21 @@ class ZxPipeline {
   VkShaderModule vertShaderModule;
   VkShaderModule fragShaderModule;
 };
+
+class ZxComputePipeline {
+ public:
+  ZxComputePipeline(
+      ZxDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+  ~ZxComputePipeline();
+
+  ZxComputePipeline(const ZxComputePipeline&) = delete;
+  ZxComputePipeline& operator=(const ZxComputePipeline&) = delete;
+
+  void bind(VkCommandBuffer commandBuffer);
+
+ private:
+  ZxDevice& zxDevice;
+  VkPipeline computePipeline;
+  VkShaderModule compShaderModule;
+};
 }
@@ -21,6 +21,7 @@ void ZxRenderer::recreateSwapChain() {
     glfwWaitEvents();
   }
   vkDeviceWaitIdle(zxDevice.device());
+  zxDevice.flushUploads();
 
   if (zxSwapChain == nullptr) {
     zxSwapChain = std::make_unique<ZxSwapChain>(zxDevice, extent);
@@ -62,6 +63,8 @@ VkCommandBuffer ZxRenderer::beginFrame() {
   assert(!isFrameStarted && "Can't call beginFrame while already in progress");
 
   auto result = zxSwapChain->acquireNextImage(&currentImageIndex);
+  // acquireNextImage waited for the fence of the frame that last used this frame index
+  zxDevice.releaseRetired(ZxSwapChain::MAX_FRAMES_IN_FLIGHT - 1);
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
     recreateSwapChain();
     return nullptr;
@@ -90,7 +93,9 @@ void ZxRenderer::endFrame() {
     panic("Failed to record command buffer!");
   }
 
+  zxDevice.submitUploads();
   auto result = zxSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+  zxDevice.frameSubmitted();
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
       zxWindow.wasWindowResized()) {
     zxWindow.resetWindowResizedFlag();
@@ -1,8 +1,14 @@
 #pragma once
 
 #include "defines.hpp"
+
+#include <cstdint>
 #include <functional>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace zx {
 
 // from: https://stackoverflow.com/a/57595105
@@ -12,4 +18,15 @@ void hashCombine(std::size_t& seed, const T& v, const Rest&... rest) {
   (hashCombine(seed, rest), ...);
 };
 
+// index of the lowest set bit, value must not be 0
+inline int countTrailingZeros(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
 }
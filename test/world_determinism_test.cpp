@@ -0,0 +1,110 @@
+// Pregenerates the same world on a single worker and on many, then checks that both hold the
+// same voxels, in the chunks and in the voxel tree, and the same faces in every chunk. Needs a
+// Vulkan device, and so a window, since World uploads what it meshes.
+//
+//   ZenixWorldTest [radius] [workers]
+
+#include "job_system.hpp"
+#include "world.hpp"
+#include "zx_device.hpp"
+#include "zx_window.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <tuple>
+
+using namespace zx;
+
+namespace {
+
+struct ChunkSums {
+  uint64_t voxels;
+  uint64_t tree;
+  uint64_t faces;
+
+  bool operator==(const ChunkSums& other) const {
+    return voxels == other.voxels && tree == other.tree && faces == other.faces;
+  }
+};
+
+struct Contents {
+  std::map<std::tuple<int, int, int>, ChunkSums> chunks;
+  size_t treeNodes = 0;
+};
+
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+Contents pregenerate(ZxDevice& device, unsigned workers, int radius) {
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / ("zenix_world_test_" + std::to_string(workers));
+  // nothing saved by an earlier run, so every chunk is generated
+  std::filesystem::remove_all(directory);
+
+  Contents contents;
+  {
+    World world{device, workers};
+    world.saveDirectory = directory.string();
+    world.enableVoxelTree();
+    world.pregenerate({0, 0}, radius);
+
+    std::array<Voxel, CHUNK_VOLUME> voxels;
+    for (const auto& chunkObject : world.chunks) {
+      const Chunk& chunk = *chunkObject->chunk;
+      ChunkSums sums{1469598103934665603ull, 1469598103934665603ull, 1469598103934665603ull};
+      chunk.voxels().decode(voxels.data());
+      sums.voxels = hashBytes(sums.voxels, voxels.data(), voxels.size());
+      world.voxelTree->readChunk(chunk.position, voxels.data());
+      sums.tree = hashBytes(sums.tree, voxels.data(), voxels.size());
+      sums.faces = hashBytes(sums.faces, chunk.mesher.faces.data(), chunk.mesher.faces.size() * sizeof(Chunk::Face));
+      contents.chunks[{chunk.position.x, chunk.position.y, chunk.position.z}] = sums;
+    }
+    contents.treeNodes = world.voxelTree->nodeCount();
+  }
+  std::filesystem::remove_all(directory);
+  return contents;
+}
+
+}
+
+int main(int argc, char** argv) {
+  int radius = argc > 1 ? std::atoi(argv[1]) : 4;
+  unsigned workers = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : JobSystem::defaultWorkerCount();
+  radius = std::max(radius, 1);
+  // more than one, or there is nothing to compare against
+  workers = std::max(workers, 4u);
+
+  ZxWindow window{64, 64, "ZenixWorldTest"};
+  ZxDevice device{window};
+
+  Contents single = pregenerate(device, 1, radius);
+  Contents many = pregenerate(device, workers, radius);
+
+  size_t mismatches = 0;
+  for (const auto& entry : single.chunks) {
+    auto other = many.chunks.find(entry.first);
+    if (other == many.chunks.end() || !(other->second == entry.second)) {
+      std::printf("chunk %d %d %d differs\n", std::get<0>(entry.first), std::get<1>(entry.first),
+                  std::get<2>(entry.first));
+      mismatches++;
+    }
+  }
+  mismatches += single.chunks.size() != many.chunks.size();
+  mismatches += single.treeNodes != many.treeNodes;
+
+  std::printf("%zu chunks, 1 against %u workers, %zu tree nodes, %zu mismatches\n", single.chunks.size(), workers,
+              single.treeNodes, mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
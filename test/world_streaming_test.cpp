@@ -0,0 +1,102 @@
+// Drives World's streaming along a straight line with small per frame limits, so the unload
+// sweep spans many frames with unloads and loads in between, and checks that every stop ends up
+// with exactly the columns within the view distance loaded and nothing beyond the unload ring.
+// Needs a Vulkan device, and so a window, since World uploads what it meshes.
+//
+//   ZenixStreamingTest [stops]
+
+#include "world.hpp"
+#include "zx_device.hpp"
+#include "zx_window.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+using namespace zx;
+
+namespace {
+
+// whether the chunks loaded around center are the ones streaming keeps there
+bool settled(const World& world, const glm::ivec2& center) {
+  int unloadDistance = world.viewDistance + world.unloadMargin;
+  for (const auto& chunkObject : world.chunks) {
+    glm::ivec3 position = chunkObject->chunk->position;
+    glm::ivec2 offset = glm::ivec2{position.x, position.z} - center;
+    if (offset.x * offset.x + offset.y * offset.y > unloadDistance * unloadDistance) {
+      return false;
+    }
+  }
+  for (int z = -world.viewDistance; z <= world.viewDistance; z++) {
+    for (int x = -world.viewDistance; x <= world.viewDistance; x++) {
+      if (x * x + z * z > world.viewDistance * world.viewDistance) {
+        continue;
+      }
+      for (int y = 0; y < World::COLUMN_HEIGHT; y++) {
+        const Chunk* chunk = world.chunks.find({center.x + x, y, center.y + z});
+        if (chunk == nullptr || chunk->generateTicket != 0) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+  int stops = argc > 1 ? std::atoi(argv[1]) : 6;
+  stops = std::max(stops, 2);
+  const int maxFrames = 20000;
+
+  ZxWindow window{64, 64, "ZenixStreamingTest"};
+  ZxDevice device{window};
+
+  std::filesystem::path directory = std::filesystem::temp_directory_path() / "zenix_streaming_test";
+  std::filesystem::remove_all(directory);
+
+  int failures = 0;
+  int frames = 0;
+  {
+    World world{device};
+    world.saveDirectory = directory.string();
+    world.viewDistance = 4;
+    world.unloadMargin = 1;
+    // small, so the sweep pauses often with unloads applied in between
+    world.columnLoadsPerFrame = 1;
+    world.chunkUnloadsPerFrame = 3;
+    world.streamingChecksPerFrame = 16;
+
+    for (int stop = 0; stop < stops; stop++) {
+      // far enough that most of the loaded columns have to go
+      glm::ivec2 center{stop * 5, stop % 2 == 0 ? 0 : 3};
+      glm::vec3 camera{(center.x + 0.5f) * CHUNK_SIZE, 0.0f, (center.y + 0.5f) * CHUNK_SIZE};
+      int stopFrames = 0;
+      for (; stopFrames < maxFrames && !settled(world, center); stopFrames++) {
+        world.updateStreaming(camera);
+        if (world.hasPendingStreaming()) {
+          world.flushStreaming();
+          // no frame submits the uploads, so their staging buffers would pile up
+          device.flushUploads();
+        } else {
+          // jobs still running
+          std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+      }
+      if (stopFrames == maxFrames) {
+        std::printf("stop %d at column %d %d did not settle\n", stop, center.x, center.y);
+        failures++;
+      }
+      frames += stopFrames;
+    }
+  }
+  std::filesystem::remove_all(directory);
+
+  std::printf("%d stops in %d frames, %d failures\n", stops, frames, failures);
+  return failures == 0 ? 0 : 1;
+}